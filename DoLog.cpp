@@ -42,14 +42,25 @@
 #include <stdexcept>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
 
-#include "DbConnect.hpp"
 
 #include "DoLogTerminationHandler.hpp"
 #include "DoLogComponentController.hpp"
 #include "DoLogTrace.hpp"
 #include "DoLogSqlValue.hpp"
 #include "DoLog.hpp"
+#include "DoLogDb.hpp"
 
 using namespace std;
 
@@ -60,14 +71,26 @@ namespace dolog
 // static objects section
 ////////////////////////////////////////////////////////////////////////////////
 
-// instance of DoLog singleton, static class variable
-DoLog *DoLog::sInstance = NULL;
+// capture context bound to the thread, static class variable
+__thread DoLog *DoLog::sInstance = NULL;
+
+// key releasing the contexts created implicitly at thread exit
+static pthread_key_t sInstanceKey;
+static pthread_once_t sInstanceKeyOnce = PTHREAD_ONCE_INIT;
 
-// LRU batch key
-static ColumnValueSet* sLastBatchKey = NULL;
+// row descriptors registered, index is the descriptor id; the descriptors
+// are read without lock as they are never changed after being published
+static RowDescriptor* sRowDescriptor[MAX_ROW_DESCRIPTOR];
+static volatile int sRowDescriptorCount = 0;
+static pthread_mutex_t sRowDescriptorMutex = PTHREAD_MUTEX_INITIALIZER;
 
-// Oracle connection
-static DbConnect sDbConnect;
+// current batch of the thread using the shared context
+static __thread DoLog* sSharedLog = NULL;
+static __thread Batch* sSharedBatch = NULL;
+static __thread BatchShard* sSharedShard = NULL;
+static __thread unsigned int sSharedGeneration = 0;
+static __thread int sSharedCustomerId = 0;
+static __thread int sSharedBillSeqNo = 0;
 
 ////////////////////////////////////////////////////////////////////////////////
 // data conversion functions
@@ -150,24 +173,31 @@ void ColumnValueSet::clear()
     }
 
     mValueContainer.clear();
+    mLabelIndex.clear();
 }
 
 // render xml format of each value (one line)
-string ColumnValueSet::getXml()
+void ColumnValueSet::writeXml(XmlSink& pSink)
 {
     SqlValue *ptr;
-    stringstream ss;
     ColumnValueContainerIt it = mValueContainer.begin();
 
     while (it != mValueContainer.end())
     {
         ptr = *it;
-        ss << ptr->getXml();
-        ss << "\n";
+        ptr->writeXml(pSink);
+        pSink << "\n";
         ++it;
     }
+}
 
-    return ss.str();
+void ColumnValueSet::writeBinary(BinaryWriter& pWriter)
+{
+    pWriter.writeUnsigned(mValueContainer.size());
+    for (ColumnValueContainerIt it = mValueContainer.begin(); it != mValueContainer.end(); ++it)
+    {
+        (*it)->writeBinary(pWriter);
+    }
 }
 
 // append a new value to the list
@@ -175,6 +205,7 @@ void ColumnValueSet::addValue(SqlValue *pValue)
 {
     TRACE(4, "ColumnValueSet::add");
     mValueContainer.push_back(pValue);
+    mLabelIndex.clear();
 }
 
 // concise presentation of the whole list of labelled values
@@ -238,11 +269,35 @@ ColumnValueSet& ColumnValueSet::operator+=(ColumnValueSet& rhs)
             this->mValueContainer.push_back(ptr->clone()); // deep copy
             ++it;
         }
+        this->mLabelIndex.clear();
     }
 
     return *this;
 }
 
+// exchange of the values between two sets, no value is copied
+void ColumnValueSet::swap(ColumnValueSet& rhs)
+{
+    mValueContainer.swap(rhs.mValueContainer);
+    mLabelIndex.swap(rhs.mLabelIndex);
+}
+
+// memory for the count of values to be added is allocated at once
+void ColumnValueSet::reserve(size_t pCount)
+{
+    mValueContainer.reserve(mValueContainer.size() + pCount);
+}
+
+// take over the values of the source set leaving it empty
+void ColumnValueSet::steal(ColumnValueSet& rhs)
+{
+    if (this != &rhs)
+    {
+        this->clear();
+        this->swap(rhs);
+    }
+}
+
 // provide a list of columns
 string ColumnValueSet::sqlColumnClause(string pSeparator)
 {
@@ -312,8 +367,18 @@ SqlValue* ColumnValueSet::sqlValue(std::string pTypeId,
 {
     TRACE(4, "ColumnValueSet::sqlValue");
 
+    return sqlValue((SqlValueType)any2int(pTypeId), Symbol(pLabel), pValue);
+}
+
+// same same but with type and label already decoded (called from dedicated XML parser)
+SqlValue* ColumnValueSet::sqlValue(SqlValueType       pTypeId,
+                                   Symbol             pLabel,
+                                   const std::string& pValue)
+{
+    TRACE(4, "ColumnValueSet::sqlValue");
+
     SqlValue *productValue = NULL;
-    SqlValueType typeId = (SqlValueType)any2int(pTypeId);
+    SqlValueType typeId = pTypeId;
 
     switch(typeId)
     {
@@ -350,7 +415,7 @@ SqlValue* ColumnValueSet::sqlValue(std::string pTypeId,
             break;
 
         default: // invalid parameter value: out of bound
-            throw(invalid_argument("Invalid TypeId value: " + pTypeId));
+            throw(invalid_argument("Invalid TypeId value: " + any2string((int)pTypeId)));
     }
 
     TRACE_MSG("SQL Value: " + productValue->getLabel() + "/" + productValue->getString());
@@ -360,45 +425,44 @@ SqlValue* ColumnValueSet::sqlValue(std::string pTypeId,
 
 // same same but using more primitive input data (called from variadic log interface)
 SqlValue* ColumnValueSet::sqlValue(HostVariableUse pUseCase,
-                                   char*           pLabel,
+                                   Symbol          pLabel,
                                    void*           pValueAny)
 {
     TRACE(4, "ColumnValueSet::sqlValue");
 
-    string label(pLabel);
     SqlValue *productValue = NULL;
     switch(pUseCase)
     {
         case VAR_REF_CHAR:
-            productValue = new SqlChar(label, pValueAny);
+            productValue = new SqlChar(pLabel, pValueAny);
             break;
 
         case VAR_REF_INTEGER:
-            productValue = new SqlInteger(label, pValueAny);
+            productValue = new SqlInteger(pLabel, pValueAny);
             break;
 
         case VAR_REF_SMALLINT:
-            productValue = new SqlSmallint(label, pValueAny);
+            productValue = new SqlSmallint(pLabel, pValueAny);
             break;
 
         case VAR_REF_FLOAT:
-            productValue = new SqlFloat(label, pValueAny);
+            productValue = new SqlFloat(pLabel, pValueAny);
             break;
 
         case VAR_REF_DOUBLE:
-            productValue = new SqlDouble(label, pValueAny);
+            productValue = new SqlDouble(pLabel, pValueAny);
             break;
 
         case VAR_REF_DATE:
-            productValue = new SqlDate(label, pValueAny);
+            productValue = new SqlDate(pLabel, pValueAny);
             break;
 
         case VAR_REF_VARCHAR:
-            productValue = new SqlVarchar(label, pValueAny);
+            productValue = new SqlVarchar(pLabel, pValueAny);
             break;
 
         case VAR_REF_LONG:
-            productValue = new SqlLong(label, pValueAny);
+            productValue = new SqlLong(pLabel, pValueAny);
             break;
 
         default:
@@ -410,26 +474,66 @@ SqlValue* ColumnValueSet::sqlValue(HostVariableUse pUseCase,
     return productValue;
 }
 
-// label lookup returning the structure pointer
+// order of values in the label index
+static bool labelLess(SqlValue* pLeft,
+                      SqlValue* pRight)
+{
+    return pLeft->getLabelSymbol() < pRight->getLabelSymbol();
+}
+
+static bool labelLessThan(SqlValue* pValue,
+                          Symbol    pLabel)
+{
+    return pValue->getLabelSymbol() < pLabel;
+}
+
+// label lookup returning the structure pointer, a label never interned
+// can not be in the set so it is not added to the symbol table
 SqlValue* ColumnValueSet::findSqlValueByLabel(const string& pLabel)
 {
-    SqlValue *finding = NULL;
-    SqlValue *ptr;
-    string searchLabel(pLabel);
-    ColumnValueContainerIt it = mValueContainer.begin();
+    Symbol label;
+    if (!Symbol::find(pLabel, label))
+    {
+        return NULL;
+    }
 
-    while (it != mValueContainer.end())
+    return findSqlValueByLabel(label);
+}
+
+// label id lookup returning the structure pointer, the small sets are
+// scanned, the bigger ones are searched in the index sorted by label id
+// built upon first lookup after the set was changed
+SqlValue* ColumnValueSet::findSqlValueByLabel(Symbol pLabel)
+{
+    if (mValueContainer.size() <= LABEL_INDEX_MIN_SIZE)
     {
-        ptr = *it;
-        if (searchLabel == ptr->getLabel())
+        for (ColumnValueContainerIt it = mValueContainer.begin(); it != mValueContainer.end(); ++it)
         {
-            finding = ptr;
-            break;
+            if ((*it)->getLabelSymbol() == pLabel)
+            {
+                return *it;
+            }
         }
-        ++it;
+
+        return NULL;
     }
 
-    return finding;
+    if (mLabelIndex.empty())
+    {
+        mLabelIndex = mValueContainer;
+        std::stable_sort(mLabelIndex.begin(), mLabelIndex.end(), labelLess);
+    }
+
+    ColumnValueContainerIt it = std::lower_bound(mLabelIndex.begin(),
+                                                 mLabelIndex.end(),
+                                                 pLabel,
+                                                 labelLessThan);
+    if (it != mLabelIndex.end() && (*it)->getLabelSymbol() == pLabel)
+    {
+        return *it;
+    }
+
+    return NULL;
 }
 
 // label lookup for value, in case of value not found return empty string
@@ -469,11 +573,10 @@ void ColumnValueSet::reassignColumnValue(ColumnValueSet* pValueSet)
     while (it != mValueContainer.end())
     {
         SqlValue *ptr = *it;
-        string label = ptr->getLabel();
-        finding = pValueSet->findSqlValueByLabel(label);
+        finding = pValueSet->findSqlValueByLabel(ptr->getLabelSymbol());
         if (NULL == finding)
         {
-            string msg("Unable assign value to variable: " + label);
+            string msg("Unable assign value to variable: " + ptr->getLabel());
             TRACE_MSG(msg);
             throw(invalid_argument(msg));
         }
@@ -484,6 +587,7 @@ void ColumnValueSet::reassignColumnValue(ColumnValueSet* pValueSet)
         }
         ++it;
     }
+    mLabelIndex.clear();
 }
 
 bool ColumnValueSet::isEmpty()
@@ -497,7 +601,7 @@ bool ColumnValueSet::isEmpty()
 // implementation of the specific operations as well as the value containers.
 ////////////////////////////////////////////////////////////////////////////////
 
-Operation::Operation(string pEntity): mEntity(pEntity)
+Operation::Operation(Symbol pEntity): mEntity(pEntity)
 {
     TRACE(2, "Operation::Operation");
 }
@@ -514,10 +618,16 @@ void Operation::addKey(SqlValue* pValue)
     mKey.addValue(pValue);
 }
 
+// the values are taken over from the set, the set is left empty
 void Operation::addKeySet(ColumnValueSet* pValueSet)
 {
     TRACE(4, "Operation::addKeySet");
-    mKey = *pValueSet;
+    mKey.steal(*pValueSet);
+}
+
+ColumnValueSet* Operation::getKeySet()
+{
+    return &mKey;
 }
 
 // the operation must know to which batch it belongs as in UPDATE case
@@ -531,7 +641,7 @@ void Operation::setBatch(Batch* pBatch)
 // OperationInsert
 ////////////////////////////////////////////////////////////////////////////////
 
-OperationInsert::OperationInsert(string pEntity): Operation(pEntity)
+OperationInsert::OperationInsert(Symbol pEntity): Operation(pEntity)
 {
     TRACE(2, "OperationInsert::OperationInsert");
 }
@@ -543,37 +653,44 @@ OperationInsert::~OperationInsert()
 }
 
 // provide the XML REDO for this batch of operations
-string OperationInsert::getXmlRedo()
+void OperationInsert::writeXmlRedo(XmlSink& pSink)
 {
-    stringstream ss;
-    ss << "<INSERT>\n";
-    ss << "<ENTITY>" << mEntity << "</ENTITY>\n";
-    ss << "<KEY>\n";
-    ss << mKey.getXml();
-    ss << "</KEY>\n";
-    ss << "<VALUE>\n";
-    ss << mValueAfter.getXml();
-    ss << "</VALUE>\n";
-    ss << "</INSERT>\n";
-    return ss.str();
+    pSink << "<INSERT>\n";
+    pSink << "<ENTITY>" << mEntity.getName() << "</ENTITY>\n";
+    pSink << "<KEY>\n";
+    mKey.writeXml(pSink);
+    pSink << "</KEY>\n";
+    pSink << "<VALUE>\n";
+    mValueAfter.writeXml(pSink);
+    pSink << "</VALUE>\n";
+    pSink << "</INSERT>\n";
 }
 
 // provide the XML UNDO (transformation is done) for this batch of operations
-string OperationInsert::getXmlUndo()
+void OperationInsert::writeXmlUndo(XmlSink& pSink)
 {
-    TRACE(4, "OperationInsert::getXmlUndo");
+    TRACE(4, "OperationInsert::writeXmlUndo");
 
-    stringstream ss;
-    ss << "<DELETE>\n";
-    ss << "<ENTITY>" << mEntity << "</ENTITY>\n";
-    ss << "<KEY>\n";
-    ss << mKey.getXml();
-    ss << "</KEY>\n";
-    ss << "<VALUE>\n";
-    ss << mValueAfter.getXml();
-    ss << "</VALUE>\n";
-    ss << "</DELETE>\n";
-    return ss.str();
+    pSink << "<DELETE>\n";
+    pSink << "<ENTITY>" << mEntity.getName() << "</ENTITY>\n";
+    pSink << "<KEY>\n";
+    mKey.writeXml(pSink);
+    pSink << "</KEY>\n";
+    pSink << "<VALUE>\n";
+    mValueAfter.writeXml(pSink);
+    pSink << "</VALUE>\n";
+    pSink << "</DELETE>\n";
+}
+
+void OperationInsert::writeBinaryUndo(BinaryWriter& pWriter)
+{
+    TRACE(4, "OperationInsert::writeBinaryUndo");
+
+    pWriter.writeByte(BINARY_TAG_OPERATION);
+    pWriter.writeByte(DELETE);
+    pWriter.writeSymbol(mEntity);
+    mKey.writeBinary(pWriter);
+    mValueAfter.writeBinary(pWriter);
 }
 
 // for Insert the only sensible value is the one after the operation
@@ -593,14 +710,14 @@ void OperationInsert::addValue(SqlValue*           pValue,
     }
 }
 
-// add the whole set of values deep assignement operator (overloaded)
+// add the whole set of values taken over from the set (overloaded)
 void OperationInsert::addValueSet(ColumnValueSet* pValueBefore,
                                   ColumnValueSet* pValueAfter)
 {
     TRACE(4, "OperationInsert::addValueSet");
     if (pValueAfter)
     {
-        mValueAfter = *pValueAfter;
+        mValueAfter.steal(*pValueAfter);
     }
 }
 
@@ -609,7 +726,7 @@ string OperationInsert::sqlStatementText()
 {
     stringstream ss;
 
-    ss << "INSERT INTO " << mEntity;
+    ss << "INSERT INTO " << mEntity.getName();
     ss << " (" << mKey.sqlColumnClause(",") << "," << mValueAfter.sqlColumnClause(",") << ") ";
     ss << "VALUES";
     ss << " (" << mKey.sqlColumnValueClause(",") << "," << mValueAfter.sqlColumnValueClause(",") << ")";
@@ -625,7 +742,7 @@ ColumnValueSet* OperationInsert::getValueSet()
 
 // match the operation by type & entity
 bool OperationInsert::isTypeEntityMatch(OperationType pType,
-                                        string        pEntity)
+                                        Symbol        pEntity)
 {
     if (pType == INSERT && pEntity == mEntity)
     {
@@ -639,7 +756,7 @@ bool OperationInsert::isTypeEntityMatch(OperationType pType,
 // OperationDelete
 ////////////////////////////////////////////////////////////////////////////////
 
-OperationDelete::OperationDelete(string pEntity): Operation(pEntity)
+OperationDelete::OperationDelete(Symbol pEntity): Operation(pEntity)
 {
     TRACE(2, "OperationDelete::OperationDelete");
 }
@@ -651,41 +768,44 @@ OperationDelete::~OperationDelete()
 }
 
 // provide the XML REDO for this batch of operations
-string OperationDelete::getXmlRedo()
+void OperationDelete::writeXmlRedo(XmlSink& pSink)
 {
-    stringstream ss;
-
-    ss << "<DELETE>\n";
-    ss << "<ENTITY>" << mEntity << "</ENTITY>\n";
-    ss << "<KEY>\n";
-    ss << mKey.getXml();
-    ss << "</KEY>\n";
-    ss << "<VALUE>\n";
-    ss << mValueBefore.getXml();
-    ss << "</VALUE>\n";
-    ss << "</DELETE>\n";
-
-    return ss.str();
+    pSink << "<DELETE>\n";
+    pSink << "<ENTITY>" << mEntity.getName() << "</ENTITY>\n";
+    pSink << "<KEY>\n";
+    mKey.writeXml(pSink);
+    pSink << "</KEY>\n";
+    pSink << "<VALUE>\n";
+    mValueBefore.writeXml(pSink);
+    pSink << "</VALUE>\n";
+    pSink << "</DELETE>\n";
 }
 
 // provide the XML UNDO (transformation is done) for this batch of operations
-string OperationDelete::getXmlUndo()
+void OperationDelete::writeXmlUndo(XmlSink& pSink)
 {
-    TRACE(4, "OperationDelete::getXmlUndo");
+    TRACE(4, "OperationDelete::writeXmlUndo");
 
-    stringstream ss;
+    pSink << "<INSERT>\n";
+    pSink << "<ENTITY>" << mEntity.getName() << "</ENTITY>\n";
+    pSink << "<KEY>\n";
+    mKey.writeXml(pSink);
+    pSink << "</KEY>\n";
+    pSink << "<VALUE>\n";
+    mValueBefore.writeXml(pSink);
+    pSink << "</VALUE>\n";
+    pSink << "</INSERT>\n";
+}
 
-    ss << "<INSERT>\n";
-    ss << "<ENTITY>" << mEntity << "</ENTITY>\n";
-    ss << "<KEY>\n";
-    ss << mKey.getXml();
-    ss << "</KEY>\n";
-    ss << "<VALUE>\n";
-    ss << mValueBefore.getXml();
-    ss << "</VALUE>\n";
-    ss << "</INSERT>\n";
+void OperationDelete::writeBinaryUndo(BinaryWriter& pWriter)
+{
+    TRACE(4, "OperationDelete::writeBinaryUndo");
 
-    return ss.str();
+    pWriter.writeByte(BINARY_TAG_OPERATION);
+    pWriter.writeByte(INSERT);
+    pWriter.writeSymbol(mEntity);
+    mKey.writeBinary(pWriter);
+    mValueBefore.writeBinary(pWriter);
 }
 
 // for Delete the only sensible value is the one before the operation
@@ -705,14 +825,14 @@ void OperationDelete::addValue(SqlValue*           pValue,
     }
 }
 
-// add the whole set of values deep assignement operator (overloaded)
+// add the whole set of values taken over from the set (overloaded)
 void OperationDelete::addValueSet(ColumnValueSet* pValueBefore,
                                   ColumnValueSet* pValueAfter)
 {
     TRACE(4, "OperationDelete::AddValueSet");
     if (pValueBefore)
     {
-        mValueBefore = *pValueBefore;
+        mValueBefore.steal(*pValueBefore);
     }
 }
 
@@ -721,7 +841,7 @@ string OperationDelete::sqlStatementText()
 {
     stringstream ss;
 
-    ss << "DELETE FROM " << mEntity << " WHERE ";
+    ss << "DELETE FROM " << mEntity.getName() << " WHERE ";
     ss << mKey.sqlColumnValueAssignClause(" AND ");
     ss << " AND ";
     ss << mValueBefore.sqlColumnValueAssignClause(" AND ");
@@ -736,7 +856,7 @@ ColumnValueSet* OperationDelete::getValueSet()
 
 // match the operation by type & entity
 bool OperationDelete::isTypeEntityMatch(OperationType pType,
-                                        string pEntity)
+                                        Symbol pEntity)
 {
     if (pType == DELETE && pEntity == mEntity)
     {
@@ -750,7 +870,7 @@ bool OperationDelete::isTypeEntityMatch(OperationType pType,
 // OperationUpdate
 ////////////////////////////////////////////////////////////////////////////////
 
-OperationUpdate::OperationUpdate(string pEntity): Operation(pEntity)
+OperationUpdate::OperationUpdate(Symbol pEntity): Operation(pEntity)
 {
     TRACE(2, "OperationUpdate::OperationUpdate");
 }
@@ -763,42 +883,67 @@ OperationUpdate::~OperationUpdate()
 }
 
 // provide the XML REDO for this batch of operations
-string OperationUpdate::getXmlRedo()
-{
-    stringstream ss;
-
-    ss << "<UPDATE>\n";
-    ss << "<ENTITY>" << mEntity << "</ENTITY>\n";
-    ss << "<KEY>\n";
-    ss << mKey.getXml();
-    ss << "</KEY>\n";
-    ss << "<VALUE>\n";
-    ss << "<BEFORE>\n";
-    ss << mValueBefore.getXml();
-    ss << "</BEFORE>\n";
-    ss << "<AFTER>\n";
-    ss << mValueAfter.getXml();
-    ss << "</AFTER>\n";
-    ss << "</VALUE>\n";
-    ss << "</UPDATE>\n";
-
-    return ss.str();
+void OperationUpdate::writeXmlRedo(XmlSink& pSink)
+{
+    pSink << "<UPDATE>\n";
+    pSink << "<ENTITY>" << mEntity.getName() << "</ENTITY>\n";
+    pSink << "<KEY>\n";
+    mKey.writeXml(pSink);
+    pSink << "</KEY>\n";
+    pSink << "<VALUE>\n";
+    pSink << "<BEFORE>\n";
+    mValueBefore.writeXml(pSink);
+    pSink << "</BEFORE>\n";
+    pSink << "<AFTER>\n";
+    mValueAfter.writeXml(pSink);
+    pSink << "</AFTER>\n";
+    pSink << "</VALUE>\n";
+    pSink << "</UPDATE>\n";
 }
 
 // provide the XML UNDO (transformation is done) for this batch of operations
 // the operation is specific as the values for it may be registered in a separate
 // SELECT operation or they may be provided as a separate VALUE block.
-string OperationUpdate::getXmlUndo()
+void OperationUpdate::writeXmlUndo(XmlSink& pSink)
+{
+    TRACE(4, "OperationUpdate::writeXmlUndo");
+
+    resolveValueBefore();
+
+    pSink << "<UPDATE>\n";
+    pSink << "<ENTITY>" << mEntity.getName() << "</ENTITY>\n";
+    pSink << "<KEY>\n";
+    mKey.writeXml(pSink);
+    pSink << "</KEY>\n";
+    pSink << "<VALUE>\n";
+    mValueBefore.writeXml(pSink);
+    pSink << "</VALUE>\n";
+    pSink << "</UPDATE>\n";
+}
+
+void OperationUpdate::writeBinaryUndo(BinaryWriter& pWriter)
 {
-    TRACE(4, "OperationUpdate::getXmlUndo");
+    TRACE(4, "OperationUpdate::writeBinaryUndo");
+
+    resolveValueBefore();
+
+    pWriter.writeByte(BINARY_TAG_OPERATION);
+    pWriter.writeByte(UPDATE);
+    pWriter.writeSymbol(mEntity);
+    mKey.writeBinary(pWriter);
+    mValueBefore.writeBinary(pWriter);
+}
 
-    stringstream    ss;
+// the value before not given explicitly is taken from the earliest SELECT
+void OperationUpdate::resolveValueBefore()
+{
+    TRACE(4, "OperationUpdate::resolveValueBefore");
 
     // try to find earliest SELECT registration
     ColumnValueSet* selectValue = mMyBatch->findFirstBatchOperation(SELECT, mEntity);
     if (selectValue == NULL && mValueBefore.isEmpty())
     {
-        string msg("SELECT not done for UPDATE on entity " + mEntity + ", no previous state infor provided");
+        string msg("SELECT not done for UPDATE on entity " + mEntity.getName() + ", no previous state infor provided");
         TRACE_MSG(msg);
         throw(invalid_argument(msg));
     }
@@ -807,18 +952,6 @@ string OperationUpdate::getXmlUndo()
         mValueBefore = mValueAfter;
         mValueBefore.reassignColumnValue(selectValue);
     }
-
-    ss << "<UPDATE>\n";
-    ss << "<ENTITY>" << mEntity << "</ENTITY>\n";
-    ss << "<KEY>\n";
-    ss << mKey.getXml();
-    ss << "</KEY>\n";
-    ss << "<VALUE>\n";
-    ss << mValueBefore.getXml();
-    ss << "</VALUE>\n";
-    ss << "</UPDATE>\n";
-
-    return ss.str();
 }
 
 // for Update the allowed values are both before and after operation
@@ -842,7 +975,7 @@ void OperationUpdate::addValue(SqlValue* pValue,
     }
 }
 
-// add the whole set of values deep assignement operator (overloaded)
+// add the whole set of values taken over from the set (overloaded)
 void OperationUpdate::addValueSet(ColumnValueSet* pValueBefore,
                                   ColumnValueSet* pValueAfter)
 {
@@ -850,12 +983,12 @@ void OperationUpdate::addValueSet(ColumnValueSet* pValueBefore,
 
     if (pValueBefore)
     {
-        mValueBefore = *pValueBefore;
+        mValueBefore.steal(*pValueBefore);
     }
 
     if (pValueAfter)
     {
-        mValueAfter = *pValueAfter;
+        mValueAfter.steal(*pValueAfter);
     }
 }
 
@@ -864,7 +997,7 @@ string OperationUpdate::sqlStatementText()
 {
     stringstream ss;
 
-    ss << "UPDATE " << mEntity;
+    ss << "UPDATE " << mEntity.getName();
     ss << " SET ";
     ss << mValueAfter.sqlColumnValueAssignClause(",");
     ss << " WHERE ";
@@ -880,7 +1013,7 @@ ColumnValueSet* OperationUpdate::getValueSet()
 
 // match the operation by type & entity
 bool OperationUpdate::isTypeEntityMatch(OperationType pType,
-                                        string        pEntity)
+                                        Symbol        pEntity)
 {
     if (pType == UPDATE && pEntity == mEntity)
     {
@@ -894,7 +1027,7 @@ bool OperationUpdate::isTypeEntityMatch(OperationType pType,
 // OperationSelect
 ////////////////////////////////////////////////////////////////////////////////
 
-OperationSelect::OperationSelect(string pEntity): Operation(pEntity)
+OperationSelect::OperationSelect(Symbol pEntity): Operation(pEntity)
 {
     TRACE(2, "OperationSelect::OperationSelect");
 }
@@ -906,19 +1039,20 @@ OperationSelect::~OperationSelect()
 }
 
 // operation not eligible for UNDO or REDO
-string OperationSelect::getXmlRedo()
+void OperationSelect::writeXmlRedo(XmlSink& pSink)
 {
-    TRACE(4, "OperationSelect::getXmlRedo");
-
-    return string("");
+    TRACE(4, "OperationSelect::writeXmlRedo");
 }
 
 // operation not eligible for UNDO or REDO
-string OperationSelect::getXmlUndo()
+void OperationSelect::writeXmlUndo(XmlSink& pSink)
 {
-    TRACE(4, "OperationSelect::getXmlUndo");
+    TRACE(4, "OperationSelect::writeXmlUndo");
+}
 
-    return string("");
+void OperationSelect::writeBinaryUndo(BinaryWriter& pWriter)
+{
+    TRACE(4, "OperationSelect::writeBinaryUndo");
 }
 
 // for Select the allowed values are only before operation
@@ -938,7 +1072,8 @@ void OperationSelect::addValue(SqlValue*           pValue,
     }
 }
 
-// for Select the only sensible values are the values before operation
+// for Select the only sensible values are the values before operation,
+// they are taken over from the set
 void OperationSelect::addValueSet(ColumnValueSet* pValueBefore,
                                   ColumnValueSet* pValueAfter)
 {
@@ -946,7 +1081,7 @@ void OperationSelect::addValueSet(ColumnValueSet* pValueBefore,
 
     if (pValueBefore)
     {
-        mValueBefore = *pValueBefore;
+        mValueBefore.steal(*pValueBefore);
     }
 }
 
@@ -956,7 +1091,7 @@ string OperationSelect::sqlStatementText()
     stringstream ss;
 
     ss << "SELECT " << mValueBefore.sqlColumnClause(",");
-    ss << " FROM " << mEntity;
+    ss << " FROM " << mEntity.getName();
     ss << " WHERE ";
     ss << mKey.sqlColumnValueClause(" AND ") << " AND " << mValueBefore.sqlColumnValueClause(" AND ");
 
@@ -970,7 +1105,7 @@ ColumnValueSet* OperationSelect::getValueSet()
 
 // match the operation by type & entity
 bool OperationSelect::isTypeEntityMatch(OperationType pType,
-                                        string pEntity)
+                                        Symbol pEntity)
 {
     if (pType == SELECT && pEntity == mEntity)
     {
@@ -984,8 +1119,8 @@ bool OperationSelect::isTypeEntityMatch(OperationType pType,
 // Batch
 ////////////////////////////////////////////////////////////////////////////////
 
-Batch::Batch(string pDigest,
-             ColumnValueSet* pBatchKey) : mDigest(pDigest), mBatchKey(pBatchKey)
+Batch::Batch(ColumnValueSet* pBatchKey) : mBatchKey(pBatchKey),
+                                           mUndoCount(0)
 {
     TRACE(2, "Batch::Batch");
 }
@@ -1002,38 +1137,60 @@ Batch::~Batch()
         delete operation;
     }
     mOperation.clear();
+    mFirstOperation.clear();
 }
 
 // provide the XML REDO for this batch of operations
-string Batch::getXmlRedo()
+void Batch::writeXmlRedo(XmlSink& pSink)
 {
     Operation* operation;
-    stringstream ss;
 
+    pSink << "<BATCH>\n";
+    pSink << "<DIGEST>" << getDigest() << "</DIGEST>\n";
+    pSink << "<KEY>\n";
+    mBatchKey->writeXml(pSink);
+    pSink << "</KEY>\n";
     for(OperationListIt it = mOperation.begin(); it != mOperation.end(); ++it)
     {
         operation = *it;
-        ss << operation->getXmlRedo();
+        operation->writeXmlRedo(pSink);
     }
-
-    return ss.str();
+    pSink << "</BATCH>\n";
 }
 
 // provide the XML UNDO (transformation is done) for this batch of operations
-string Batch::getXmlUndo()
+void Batch::writeXmlUndo(XmlSink& pSink)
 {
-    TRACE(4, "Batch::getXmlUndo");
+    TRACE(4, "Batch::writeXmlUndo");
 
     Operation* operation;
-    stringstream ss;
 
+    pSink << "<BATCH>\n";
+    pSink << "<DIGEST>" << getDigest() << "</DIGEST>\n";
+    pSink << "<KEY>\n";
+    mBatchKey->writeXml(pSink);
+    pSink << "</KEY>\n";
     for(OperationListRevIt it = mOperation.rbegin(); it != mOperation.rend(); ++it)
     {
         operation = *it;
-        ss << operation->getXmlUndo();
+        operation->writeXmlUndo(pSink);
     }
+    pSink << "</BATCH>\n";
+}
 
-    return ss.str();
+// the digest is not written, it is built from the key upon load
+void Batch::writeBinaryUndo(BinaryWriter& pWriter)
+{
+    TRACE(4, "Batch::writeBinaryUndo");
+
+    pWriter.beginBatch();
+    pWriter.writeByte(BINARY_TAG_BATCH);
+    mBatchKey->writeBinary(pWriter);
+    for(OperationListRevIt it = mOperation.rbegin(); it != mOperation.rend(); ++it)
+    {
+        (*it)->writeBinaryUndo(pWriter);
+    }
+    pWriter.writeByte(BINARY_TAG_BATCH_END);
 }
 
 // execute all SQL statements from the container provided
@@ -1048,26 +1205,52 @@ void Batch::sqlStatementTextAll(StringVector& pSqlTextContainer)
     }
 }
 
+// append the operation keeping the first one on each type & entity indexed
+void Batch::addOperation(Operation*    pOperation,
+                         OperationType pType,
+                         Symbol        pEntity)
+{
+    mOperation.push_back(pOperation);
+    mFirstOperation.insert(make_pair(OperationTypeEntity(pType, pEntity.getId()), pOperation));
+    if (pType != SELECT)
+    {
+        mUndoCount++;
+    }
+}
+
+// the operations of the other batch are appended in their order, the same
+// as if they were added one by one
+void Batch::append(Batch& rhs)
+{
+    for (OperationListIt it = rhs.mOperation.begin(); it != rhs.mOperation.end(); ++it)
+    {
+        (*it)->setBatch(this);
+    }
+    mOperation.splice(mOperation.end(), rhs.mOperation);
+    mUndoCount += rhs.mUndoCount;
+    rhs.mUndoCount = 0;
+
+    // first operation is kept if already found in this batch
+    for (OperationIndexIt it = rhs.mFirstOperation.begin(); it != rhs.mFirstOperation.end(); ++it)
+    {
+        mFirstOperation.insert(*it);
+    }
+    rhs.mFirstOperation.clear();
+}
+
 // search the given batch for first operation on type & entity
-// but only for the povided column names of the key
-// if found return pointer
+// if found return pointer to its values
 // if not found return NULL
 ColumnValueSet* Batch::findFirstBatchOperation(OperationType pType,
-                                               string        mEntity)
+                                               Symbol        pEntity)
 {
-    ColumnValueSet* finding = NULL;
-
-    for(OperationListIt it = mOperation.begin(); it != mOperation.end(); ++it)
+    OperationIndexIt it = mFirstOperation.find(OperationTypeEntity(pType, pEntity.getId()));
+    if (it != mFirstOperation.end())
     {
-        Operation* operation = *it;
-        if (operation->isTypeEntityMatch(pType, mEntity))
-        {
-            finding = operation->getValueSet();
-            break;
-        }
+        return it->second->getValueSet();
     }
 
-    return finding;
+    return NULL;
 }
 
 ColumnValueSet* Batch::getBatchKey()
@@ -1075,319 +1258,1732 @@ ColumnValueSet* Batch::getBatchKey()
     return mBatchKey;
 }
 
+// the digest is needed only when the batch is written
+const string& Batch::getDigest()
+{
+    if (mDigest.empty())
+    {
+        mDigest = mBatchKey->getDigest();
+    }
+
+    return mDigest;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
-// DoLog
+// RowDescriptor
 ////////////////////////////////////////////////////////////////////////////////
 
-// default mode: file processing, no DB needed
-DoLog::DoLog() : mHandleDbConnect(false), mDbHandle("")
+// least size of host variable, the char sequences and varchars are
+// only known to take their first byte or the length
+static size_t hostVariableSize(HostVariableUse pUse)
 {
-    TRACE(1, "DoLog::DoLog");
-}
+    switch(pUse)
+    {
+        case VAR_REF_INTEGER:
+            return sizeof(int);
 
-// deep release whole memory for all batches regstered
-DoLog::~DoLog()
-{
-    TRACE(1, "DoLog::~DoLog");
-    clean();
-}
+        case VAR_REF_SMALLINT:
+            return sizeof(short);
 
-// singleton idiom: only one instance of the object
-DoLog* DoLog::getInstance()
-{
-    if (!sInstance)
-    {
-        sInstance = new DoLog;
-    }
+        case VAR_REF_FLOAT:
+            return sizeof(float);
 
-    return sInstance;
-}
+        case VAR_REF_DOUBLE:
+            return sizeof(double);
 
-// deep release of memory of all batches from the container
-void DoLog::clean()
-{
-    TRACE(1, "DoLog::Clean");
-    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
-    {
-        delete it->second;
+        case VAR_REF_VARCHAR:
+            return offsetof(Varchar, arr);
+
+        case VAR_REF_LONG:
+            return sizeof(long);
+
+        default:
+            return 1;
     }
-    mBatchContainer.clear();
 }
 
-// find batch key by digest string
-ColumnValueSet* DoLog::findBatchKey(string& pSearchDigest)
+// the columns are validated and their labels interned upon registration
+RowDescriptor::RowDescriptor(Symbol           pEntity,
+                             const RowColumn* pColumn,
+                             int              pColumnCount) : mEntity(pEntity),
+                                                              mRowExtent(0)
 {
-    ColumnValueSet* foundKey = NULL;
+    TRACE(2, "RowDescriptor::RowDescriptor");
 
-    BatchContainerIt it = mBatchContainer.find(pSearchDigest);
-    if (it != mBatchContainer.end())
+    for (int i = 0; i < pColumnCount; i++)
+    {
+        const RowColumn& column = pColumn[i];
+        if (column.use < VAR_REF_CHAR || column.use > VAR_REF_LONG)
+        {
+            throw(invalid_argument("Invalid HostVariableUse value: " + convertHostVariableUse2string(column.use)));
+        }
+
+        if (!column.label)
+        {
+            throw(invalid_argument("Missing label"));
+        }
+
+        RowDescriptorColumn descriptorColumn;
+        descriptorColumn.use = column.use;
+        descriptorColumn.label = Symbol(column.label);
+        descriptorColumn.offset = column.offset;
+
+        size_t extent = column.offset + hostVariableSize(column.use);
+        if (extent > mRowExtent)
+        {
+            mRowExtent = extent;
+        }
+
+        if (column.section == KEY)
+        {
+            mKey.push_back(descriptorColumn);
+        }
+        else if (column.section == VALUE)
+        {
+            mValue.push_back(descriptorColumn);
+        }
+        else
+        {
+            throw(invalid_argument("Invalid section, only KEY or VALUE allowed"));
+        }
+    }
+
+    if (mKey.empty())
     {
-        // operation indexed by the key was already found in the map
-        Batch* batch = it->second;
-        foundKey = batch->mBatchKey;
+        throw(invalid_argument("KEY section not defined"));
     }
 
-    return foundKey;
+    if (mValue.empty())
+    {
+        throw(invalid_argument("VALUE section not defined"));
+    }
 }
 
-// build new batch and init it with first value
-Batch* DoLog::addBatch(string&         pSearchDigest,
-                       ColumnValueSet* pKey)
+Symbol RowDescriptor::getEntity()
 {
-    Batch* batch = new Batch(pSearchDigest, pKey);
-    mBatchContainer.insert(pair<string, Batch*>(pSearchDigest, batch));
-    return batch;
+    return mEntity;
 }
 
-// operations factory: produces operations stored in indexed batches
-Operation* DoLog::sqlOperation(ColumnValueSet* pBatchKey,
-                               OperationType   pOperationType,
-                               string          pEntity)
+void RowDescriptor::getKeySet(const void*     pRow,
+                              ColumnValueSet& pKeySet)
 {
-    TRACE(2, "DoLog::sqlOperation");
+    getColumnValueSet(mKey, pRow, pKeySet);
+}
 
-    // always new operation to be produced by the factory upon call
+void RowDescriptor::getValueSet(const void*     pRow,
+                                ColumnValueSet& pValueSet)
+{
+    getColumnValueSet(mValue, pRow, pValueSet);
+}
 
-    TRACE_MSG(convertOperationType2string(pOperationType) + " -> " + pEntity);
-    Operation* operation;
-    switch(pOperationType)
+// one pass over the columns reading the host variables at their offsets
+void RowDescriptor::getColumnValueSet(RowDescriptorColumnContainer& pColumn,
+                                      const void*                   pRow,
+                                      ColumnValueSet&               pValueSet)
+{
+    char* row = (char *)pRow;
+    pValueSet.reserve(pColumn.size());
+    for (RowDescriptorColumnContainer::iterator it = pColumn.begin(); it != pColumn.end(); ++it)
     {
-        case INSERT:
-            operation = new OperationInsert(pEntity);
-            break;
-
-        case DELETE:
-            operation = new OperationDelete(pEntity);
-            break;
-
-        case UPDATE:
-            operation = new OperationUpdate(pEntity);
-            break;
-
-        case SELECT:
-            operation = new OperationSelect(pEntity);
-            break;
-
-        default: throw invalid_argument("Wrong operation type, only INSERT, DELETE, UPDATE, SELECT allowed");
+        pValueSet.addValue(pValueSet.sqlValue(it->use, it->label, row + it->offset));
     }
+}
 
-    // create new or reuse existing batch
-    Batch* batch;
-    string batchKeyDigest = pBatchKey->getDigest();
-    BatchContainerIt it = mBatchContainer.find(batchKeyDigest);
-    if (it == mBatchContainer.end())
-    { // new operation for a given key
-        batch = addBatch(batchKeyDigest, pBatchKey);
-    }
-    else
-    {   // operation indexed by the key was already found in the map
-        batch = it->second;
-    }
+////////////////////////////////////////////////////////////////////////////////
+// BatchIndex
+////////////////////////////////////////////////////////////////////////////////
 
-    // the operations must be kept sorted by priority of the entities
-    batch->mOperation.push_back(operation);
+BatchIndex::BatchIndex() : mCount(0)
+{
+    BatchIndexSlot empty = { 0, 0, NULL };
+    mSlot.resize(BATCH_INDEX_INIT_SIZE, empty);
+}
 
-    // linking the operation with it's batch (usefull in search for own operations)
-    operation->setBatch(batch);
+// mix both values of the batch key
+static unsigned int batchKeyHash(int pCustomerId,
+                                 int pBillSeqNo)
+{
+    unsigned int hash = (unsigned int)pCustomerId * 0x9E3779B1u;
+    hash ^= (unsigned int)pBillSeqNo * 0x85EBCA6Bu;
+    hash ^= hash >> 16;
 
-    return operation;
+    return hash;
 }
 
-// get  the XML image of REDO operations for all batch containers registered
-string DoLog::getXmlRedo()
+// the table size is a power of 2
+size_t BatchIndex::slotOf(int pCustomerId,
+                          int pBillSeqNo)
 {
-    TRACE(1, "DoLog::getXmlRedo");
-
-    stringstream ss;
+    return batchKeyHash(pCustomerId, pBillSeqNo) & (mSlot.size() - 1);
+}
 
-    ss << "<REDOLOG>\n";
-    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+// linear probing until the key or an empty slot is found
+Batch* BatchIndex::find(int pCustomerId,
+                        int pBillSeqNo)
+{
+    size_t mask = mSlot.size() - 1;
+    for (size_t i = slotOf(pCustomerId, pBillSeqNo); mSlot[i].batch; i = (i + 1) & mask)
     {
-        Batch *batch = it->second;
-        ss << "<BATCH>\n";
-        ss << "<DIGEST>" << it->first << "</DIGEST>\n";
-        ss << "<KEY>\n";
-        ss << batch->mBatchKey->getXml();
-        ss << "</KEY>\n";
-        ss << batch->getXmlRedo();
-        ss << "</BATCH>\n";
+        if (mSlot[i].customerId == pCustomerId &&
+            mSlot[i].billSeqNo == pBillSeqNo)
+        {
+            return mSlot[i].batch;
+        }
     }
-    ss << "</REDOLOG>\n";
 
-    return ss.str();
+    return NULL;
 }
 
-// get the XML image of UNDO operations (transformation is done) for all batch containers registered
-string DoLog::getXmlUndo()
+// the key must not be in the table yet, load factor kept below 1/2
+void BatchIndex::insert(int    pCustomerId,
+                        int    pBillSeqNo,
+                        Batch* pBatch)
 {
-    TRACE(1, "DoLog::getXmlUndo");
-
-    stringstream ss;
+    if (2 * (mCount + 1) > mSlot.size())
+    {
+        grow();
+    }
 
-    ss << "<UNDOLOG>\n";
-    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    size_t mask = mSlot.size() - 1;
+    size_t i = slotOf(pCustomerId, pBillSeqNo);
+    while (mSlot[i].batch)
     {
-        Batch *batch = it->second;
-        ss << "<BATCH>\n";
-        ss << "<DIGEST>" << it->first << "</DIGEST>\n";
-        ss << "<KEY>\n";
-        ss << batch->mBatchKey->getXml();
-        ss << "</KEY>\n";
-        ss << batch->getXmlUndo();
-        ss << "</BATCH>\n";
+        i = (i + 1) & mask;
     }
-    ss << "</UNDOLOG>\n";
 
-    return ss.str();
+    mSlot[i].customerId = pCustomerId;
+    mSlot[i].billSeqNo = pBillSeqNo;
+    mSlot[i].batch = pBatch;
+    mCount++;
 }
 
-// execute all SQL statements from the container
-void DoLog::sqlStatementTextAll(StringVector& pSqlTextContainer)
+// the slots stay allocated for the next flush
+void BatchIndex::clear()
 {
-    TRACE(1, "DoLog::sqlStatementTextAll");
-
-    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    if (mCount)
     {
-        Batch* batch = it->second;
-        batch->sqlStatementTextAll(pSqlTextContainer);
+        BatchIndexSlot empty = { 0, 0, NULL };
+        std::fill(mSlot.begin(), mSlot.end(), empty);
+        mCount = 0;
     }
 }
 
-// save all operations for all batches in one file
-bool DoLog::save(const char* pFileName)
+// rehash of all the entries into the table of double size
+void BatchIndex::grow()
 {
-    TRACE(1, "DoLog::save");
+    BatchIndexSlot empty = { 0, 0, NULL };
+    std::vector<BatchIndexSlot> slot(2 * mSlot.size(), empty);
+    slot.swap(mSlot);
+    mCount = 0;
 
-    stringstream ss;
+    for (size_t i = 0; i < slot.size(); i++)
+    {
+        if (slot[i].batch)
+        {
+            insert(slot[i].customerId, slot[i].billSeqNo, slot[i].batch);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BatchStore
+////////////////////////////////////////////////////////////////////////////////
+
+BatchStore::BatchStore(size_t pShardCount) : mGeneration(0)
+{
+    for (size_t i = 0; i < pShardCount; i++)
+    {
+        BatchShard* shard = new BatchShard;
+        pthread_mutex_init(&shard->mutex, NULL);
+        mShard.push_back(shard);
+    }
+    pthread_mutex_init(&mFlushMutex, NULL);
+}
+
+// the batches must be collected before
+BatchStore::~BatchStore()
+{
+    for (size_t i = 0; i < mShard.size(); i++)
+    {
+        pthread_mutex_destroy(&mShard[i]->mutex);
+        delete mShard[i];
+    }
+    pthread_mutex_destroy(&mFlushMutex);
+}
+
+// the index of the shard uses other bits of hash than the index in the shard
+BatchShard* BatchStore::shardOf(int pCustomerId,
+                                int pBillSeqNo)
+{
+    return mShard[(batchKeyHash(pCustomerId, pBillSeqNo) >> 20) % mShard.size()];
+}
+
+// take over batches of all shards at once, the current batches of the threads
+// are not valid any more
+void BatchStore::collect(BatchContainer& pBatchContainer)
+{
+    for (size_t i = 0; i < mShard.size(); i++)
+    {
+        pthread_mutex_lock(&mShard[i]->mutex);
+    }
+
+    for (size_t i = 0; i < mShard.size(); i++)
+    {
+        BatchShard* shard = mShard[i];
+        pBatchContainer.insert(pBatchContainer.end(), shard->batch.begin(), shard->batch.end());
+        shard->batch.clear();
+        shard->index.clear();
+    }
+    mGeneration++;
+
+    for (size_t i = mShard.size(); i > 0; i--)
+    {
+        pthread_mutex_unlock(&mShard[i - 1]->mutex);
+    }
+}
+
+unsigned int BatchStore::getGeneration()
+{
+    return mGeneration;
+}
+
+pthread_mutex_t* BatchStore::getFlushMutex()
+{
+    return &mFlushMutex;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FlushHandle
+////////////////////////////////////////////////////////////////////////////////
+
+FlushHandle::FlushHandle() : mLog(NULL),
+                             mWriter(NULL),
+                             mSpillFile(NULL),
+                             mIsPending(false),
+                             mIsSaved(true)
+{}
+
+// writer thread: the batches are saved, released and committed
+void* FlushHandle::start(void* pHandle)
+{
+    TRACE(1, "FlushHandle::start");
+
+    FlushHandle* handle = (FlushHandle *)pHandle;
+    DoLog* writer = handle->mWriter;
+    try
+    {
+        handle->mIsSaved = writer->save(handle->mBatchContainer,
+                                        handle->mSpillFile,
+                                        handle->mSpillIndex);
+        writer->releaseBatches(handle->mBatchContainer, handle->mArena);
+        if (handle->mSpillFile)
+        {
+            fclose(handle->mSpillFile);
+            handle->mSpillFile = NULL;
+        }
+        handle->mSpillIndex.clear();
+        writer->commit();
+    }
+    catch (exception &e)
+    {
+        handle->mIsSaved = false;
+        ERROR("Exception caught in writer thread, " + string(e.what()));
+    }
+
+    return NULL;
+}
+
+// the result of the last flush, the writer thread is joined once
+bool FlushHandle::wait()
+{
+    if (mIsPending)
+    {
+        pthread_join(mThread, NULL);
+        mIsPending = false;
+        collectStatistics();
+    }
+
+    return mIsSaved;
+}
+
+// statistics of the writer reported by the context once the writer is done
+void FlushHandle::collectStatistics()
+{
+    mLog->mSeqNoFetchCount = mWriter->mSeqNoFetchCount;
+    mLog->mSeqNoKeyCount = mWriter->mSeqNoKeyCount;
+    if (mWriter->mImageHighWaterMark > mLog->mImageHighWaterMark)
+    {
+        mLog->mImageHighWaterMark = mWriter->mImageHighWaterMark;
+    }
+    if (mWriter->mArenaHighWaterMark > mLog->mArenaHighWaterMark)
+    {
+        mLog->mArenaHighWaterMark = mWriter->mArenaHighWaterMark;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// LoadPipeline
+////////////////////////////////////////////////////////////////////////////////
+
+LoadPipeline::LoadPipeline(DoLog* pLog,
+                           int    pWorkerCount) : mLog(pLog),
+                                                  mStarted(0),
+                                                  mIsStopped(false)
+{
+    TRACE(2, "LoadPipeline::LoadPipeline");
+
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mWork, NULL);
+    pthread_cond_init(&mDone, NULL);
+
+    for (int i = 0; i < pWorkerCount * LOAD_JOBS_PER_WORKER; i++)
+    {
+        LoadJob* job = new LoadJob;
+        job->seqNo = 0;
+        job->buffer = NULL;
+        job->bufferLength = 0;
+        job->image = NULL;
+        job->imageLength = 0;
+        job->isDone = false;
+        mJob.push_back(job);
+        mFreeJob.push_back(job);
+    }
+
+    // each thread parses with the settings of the loading context
+    for (int i = 0; i < pWorkerCount; i++)
+    {
+        DoLog* worker = new DoLog;
+        worker->mXmlParser = pLog->mXmlParser;
+        mWorker.push_back(worker);
+    }
+
+    for (int i = 0; i < pWorkerCount; i++)
+    {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, LoadPipeline::start, this) != 0)
+        {
+            break;
+        }
+        mThread.push_back(thread);
+    }
+    TRACE_MSG("Started parser threads: " + any2string(mThread.size()));
+}
+
+// the records not taken back are dropped, the memory of batches merged into
+// the loading context is taken over by its arena
+LoadPipeline::~LoadPipeline()
+{
+    TRACE(2, "LoadPipeline::~LoadPipeline");
+
+    pthread_mutex_lock(&mMutex);
+    mIsStopped = true;
+    pthread_cond_broadcast(&mWork);
+    pthread_mutex_unlock(&mMutex);
+    for (size_t i = 0; i < mThread.size(); i++)
+    {
+        pthread_join(mThread[i], NULL);
+    }
+    mThread.clear();
+
+    for (size_t i = 0; i < mJob.size(); i++)
+    {
+        for (BatchContainerIt it = mJob[i]->batch.begin(); it != mJob[i]->batch.end(); ++it)
+        {
+            delete *it;
+        }
+        free(mJob[i]->buffer);
+        delete mJob[i];
+    }
+    mJob.clear();
+
+    for (size_t i = 0; i < mWorker.size(); i++)
+    {
+        mLog->mArena.adopt(mWorker[i]->mArena);
+        delete mWorker[i];
+    }
+    mWorker.clear();
+
+    pthread_cond_destroy(&mDone);
+    pthread_cond_destroy(&mWork);
+    pthread_mutex_destroy(&mMutex);
+}
+
+void* LoadPipeline::start(void* pPipeline)
+{
+    ((LoadPipeline *)pPipeline)->run();
+
+    return NULL;
+}
+
+// parser thread: the batches of each record are built in the arena of
+// the thread context and handed over with the record
+void LoadPipeline::run()
+{
+    TRACE(2, "LoadPipeline::run");
+
+    pthread_mutex_lock(&mMutex);
+    DoLog* worker = mWorker[mStarted++];
+    pthread_mutex_unlock(&mMutex);
+    Arena::setCurrent(&worker->mArena);
+
+    while (true)
+    {
+        pthread_mutex_lock(&mMutex);
+        while (mQueue.empty() && !mIsStopped)
+        {
+            pthread_cond_wait(&mWork, &mMutex);
+        }
+        if (mIsStopped)
+        {
+            pthread_mutex_unlock(&mMutex);
+            break;
+        }
+        LoadJob* job = mQueue.front();
+        mQueue.pop_front();
+        pthread_mutex_unlock(&mMutex);
+
+        job->errmsg = worker->parseRecord(job->image, job->imageLength);
+        job->batch.swap(worker->mBatchContainer);
+        worker->mBatchDigestIndex.clear();
+        worker->mLastBatchKey = NULL;
+        worker->mLastBatch = NULL;
+
+        pthread_mutex_lock(&mMutex);
+        job->isDone = true;
+        pthread_cond_broadcast(&mDone);
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    Arena::setCurrent(NULL);
+}
+
+// number of parser threads started, 0 - the records must be parsed serially
+size_t LoadPipeline::getWorkerCount()
+{
+    return mThread.size();
+}
+
+bool LoadPipeline::isFull()
+{
+    return mFreeJob.empty();
+}
+
+// job to be filled by the loading thread, NULL - all jobs in progress
+LoadJob* LoadPipeline::getFreeJob()
+{
+    if (mFreeJob.empty())
+    {
+        return NULL;
+    }
+
+    LoadJob* job = mFreeJob.back();
+    mFreeJob.pop_back();
+
+    return job;
+}
+
+void LoadPipeline::submit(LoadJob* pJob)
+{
+    pJob->isDone = false;
+    pJob->errmsg.clear();
+    mInFlight.push_back(pJob);
+
+    pthread_mutex_lock(&mMutex);
+    mQueue.push_back(pJob);
+    pthread_cond_signal(&mWork);
+    pthread_mutex_unlock(&mMutex);
+}
+
+// first record fetched if already parsed, its batches are merged into
+// the loading context
+LoadJob* LoadPipeline::nextDone(bool pWait)
+{
+    if (mInFlight.empty())
+    {
+        return NULL;
+    }
+
+    LoadJob* job = mInFlight.front();
+    pthread_mutex_lock(&mMutex);
+    while (pWait && !job->isDone)
+    {
+        pthread_cond_wait(&mDone, &mMutex);
+    }
+    bool isDone = job->isDone;
+    pthread_mutex_unlock(&mMutex);
+
+    if (!isDone)
+    {
+        return NULL;
+    }
+
+    mInFlight.pop_front();
+    mLog->mergeBatches(job->batch);
+
+    return job;
+}
+
+void LoadPipeline::release(LoadJob* pJob)
+{
+    mFreeJob.push_back(pJob);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DoLog
+////////////////////////////////////////////////////////////////////////////////
+
+// default mode: file processing, no DB needed
+DoLog::DoLog() : mIsThreadOwned(false),
+                 mHandleDbConnect(false),
+                 mDbHandle(strdup("")),
+                 mSqlContext(NULL),
+                 mIsSqlContextOwned(false),
+                 mLastBatchKey(NULL),
+                 mLastBatch(NULL),
+                 mCurrentBatch(NULL),
+                 mBatchStore(NULL),
+                 mInsertArraySize(DEFAULT_INSERT_ARRAY_SIZE),
+                 mInsertArray(NULL),
+                 mSeqNoNext(0),
+                 mSeqNoFetchCount(0),
+                 mSeqNoKeyCount(0),
+                 mImage(LONG_VARCHAR_LEN_SIZE),
+                 mImageHighWaterMark(0),
+                 mSelectBuffer(NULL),
+                 mSelectBufferLength(0),
+                 mArenaHighWaterMark(0),
+                 mMemoryBudget(0),
+                 mSpillFile(NULL),
+                 mSpillCount(0),
+                 mFormat(UNDOLOG_FORMAT_XML),
+                 mBatchCallback(NULL),
+                 mBatchCallbackData(NULL),
+                 mXmlParser(XML_PARSER_XERCES),
+                 mLoadWorkerCount(DEFAULT_LOAD_WORKER_COUNT)
+{
+    TRACE(1, "DoLog::DoLog");
+    mFlush.mLog = this;
+}
+
+// deep release whole memory for all batches regstered
+DoLog::~DoLog()
+{
+    TRACE(1, "DoLog::~DoLog");
+    mFlush.wait();
+    delete mFlush.mWriter;
+    if (mBatchStore)
+    {
+        mBatchStore->collect(mBatchContainer);
+    }
+    clean();
+    delete mBatchStore;
+    dbInsertArrayRelease();
+    free(mSelectBuffer);
+    dbRelease();
+    free(mDbHandle);
+}
+
+// thread exit: only the context created upon first use is still set in the key
+static void releaseInstance(void* pContext)
+{
+    DoLog::setInstance(NULL);
+    delete (DoLog *)pContext;
+}
+
+static void createInstanceKey()
+{
+    pthread_key_create(&sInstanceKey, releaseInstance);
+}
+
+// context of the calling thread, created upon first use
+DoLog* DoLog::getInstance()
+{
+    if (!sInstance)
+    {
+        DoLog* context = new DoLog;
+        setInstance(context);
+        context->mIsThreadOwned = true;
+        pthread_setspecific(sInstanceKey, context);
+    }
+
+    return sInstance;
+}
+
+// context bound to the calling thread, none is created
+DoLog* DoLog::findInstance()
+{
+    return sInstance;
+}
+
+// bind context to the calling thread, all batches registered from now on
+// by the thread are allocated in the arena of the context; the arena is not
+// used by the context shared by many threads
+DoLog* DoLog::setInstance(DoLog* pContext)
+{
+    pthread_once(&sInstanceKeyOnce, createInstanceKey);
+
+    DoLog* previous = sInstance;
+    if (previous && previous->mIsThreadOwned)
+    {
+        // the caller takes over the context
+        previous->mIsThreadOwned = false;
+        pthread_setspecific(sInstanceKey, NULL);
+    }
+
+    sInstance = pContext;
+    Arena::setCurrent(pContext && !pContext->mBatchStore ? &pContext->mArena : NULL);
+
+    return previous;
+}
+
+// deep release of memory of all batches from the container, the objects
+// are destructed but their memory is returned at once by rewind of the arena.
+// It is not constant time: each object is still visited by its destructor,
+// since the label attributes, the long string values and the batch digest
+// are kept in strings and maps on the heap.
+void DoLog::clean()
+{
+    TRACE(1, "DoLog::Clean");
+    releaseBatches(mBatchContainer, mArena);
+    mBatchIndex.clear();
+    mBatchDigestIndex.clear();
+    mLastBatchKey = NULL;
+    mLastBatch = NULL;
+
+    // temporary file is removed upon close
+    if (mSpillFile)
+    {
+        fclose(mSpillFile);
+        mSpillFile = NULL;
+    }
+    mSpillIndex.clear();
+    mSpillCount = 0;
+}
+
+// the batches are destructed one by one, so their heap strings are freed, but
+// their own memory is returned by rewind of the arena
+void DoLog::releaseBatches(BatchContainer& pBatchContainer,
+                           Arena&          pArena)
+{
+    for(BatchContainerIt it = pBatchContainer.begin(); it != pBatchContainer.end(); ++it)
+    {
+        delete *it;
+    }
+    pBatchContainer.clear();
+
+    if (pArena.getBytesUsed() > mArenaHighWaterMark)
+    {
+        mArenaHighWaterMark = pArena.getBytesUsed();
+    }
+    pArena.reset();
+}
+
+// find batch registered with logUndoBatch, no memory allocated
+Batch* DoLog::findBatch(int pCustomerId,
+                        int pBillSeqNo)
+{
+    return mBatchIndex.find(pCustomerId, pBillSeqNo);
+}
+
+// labels of the key of logUndoBatch, interned once
+static const Symbol& billSeqNoLabel()
+{
+    static const Symbol sLabel("BILLSEQNO");
+    return sLabel;
+}
+
+static const Symbol& customerIdLabel()
+{
+    static const Symbol sLabel("CUSTOMER_ID");
+    return sLabel;
+}
+
+// new batch with the key of logUndoBatch
+static Batch* newBatch(int pCustomerId,
+                       int pBillSeqNo)
+{
+    ColumnValueSet* key = new ColumnValueSet;
+    key->addValue(new SqlInteger(billSeqNoLabel(), pBillSeqNo));
+    key->addValue(new SqlInteger(customerIdLabel(), pCustomerId));
+
+    return new Batch(key);
+}
+
+// build new batch with the key of logUndoBatch
+Batch* DoLog::addBatch(int pCustomerId,
+                       int pBillSeqNo)
+{
+    Batch* batch = newBatch(pCustomerId, pBillSeqNo);
+    mBatchContainer.push_back(batch);
+    mBatchIndex.insert(pCustomerId, pBillSeqNo, batch);
+
+    return batch;
+}
+
+// find batch with any key by its digest string, the key of the batch
+// found last is remembered as the same key is used for all its operations
+Batch* DoLog::findBatch(ColumnValueSet* pKey)
+{
+    if (pKey == mLastBatchKey)
+    {
+        return mLastBatch;
+    }
+
+    Batch* batch = NULL;
+    BatchDigestIndexIt it = mBatchDigestIndex.find(pKey->getDigest());
+    if (it != mBatchDigestIndex.end())
+    {
+        batch = it->second;
+        mLastBatchKey = pKey;
+        mLastBatch = batch;
+    }
+
+    return batch;
+}
+
+// build new batch with any key, the batch takes ownership of the key
+Batch* DoLog::addBatch(ColumnValueSet* pKey)
+{
+    Batch* batch = new Batch(pKey);
+    mBatchContainer.push_back(batch);
+    mBatchDigestIndex.insert(pair<string, Batch*>(batch->getDigest(), batch));
+    mLastBatchKey = pKey;
+    mLastBatch = batch;
+
+    return batch;
+}
+
+// shared context: the batch is found or added under lock of its shard only
+// and it is remembered as the current batch of the calling thread
+void DoLog::useSharedBatch(int pCustomerId,
+                           int pBillSeqNo)
+{
+    BatchShard* shard = mBatchStore->shardOf(pCustomerId, pBillSeqNo);
+    MutexLock lock(&shard->mutex);
+
+    sSharedLog = this;
+    sSharedShard = shard;
+    sSharedCustomerId = pCustomerId;
+    sSharedBillSeqNo = pBillSeqNo;
+    sSharedBatch = findSharedBatch(shard, pCustomerId, pBillSeqNo);
+    sSharedGeneration = mBatchStore->getGeneration();
+}
+
+// the batch of the key in the shard locked by the caller, added if missing
+Batch* DoLog::findSharedBatch(BatchShard* pShard,
+                              int         pCustomerId,
+                              int         pBillSeqNo)
+{
+    Batch* batch = pShard->index.find(pCustomerId, pBillSeqNo);
+    if (!batch)
+    {
+        batch = newBatch(pCustomerId, pBillSeqNo);
+        pShard->batch.push_back(batch);
+        pShard->index.insert(pCustomerId, pBillSeqNo, batch);
+    }
+
+    return batch;
+}
+
+// current batch of the thread, in shared context its shard stays locked
+// until unlockCurrentBatch; NULL - no batch, nothing locked
+Batch* DoLog::lockCurrentBatch()
+{
+    if (!mBatchStore)
+    {
+        return mCurrentBatch;
+    }
+
+    if (sSharedLog != this || !sSharedShard)
+    {
+        return NULL;
+    }
+
+    // the batch was taken by flush done since logUndoBatch, possibly by
+    // other thread, the key of the thread is used again in the same shard
+    pthread_mutex_lock(&sSharedShard->mutex);
+    if (sSharedGeneration != mBatchStore->getGeneration())
+    {
+        sSharedBatch = findSharedBatch(sSharedShard, sSharedCustomerId, sSharedBillSeqNo);
+        sSharedGeneration = mBatchStore->getGeneration();
+    }
+
+    return sSharedBatch;
+}
+
+void DoLog::unlockCurrentBatch()
+{
+    if (mBatchStore)
+    {
+        pthread_mutex_unlock(&sSharedShard->mutex);
+    }
+}
+
+// operations factory: produces operations stored in batches found by key,
+// the key is taken over only by a new batch
+Operation* DoLog::sqlOperation(ColumnValueSet* pBatchKey,
+                               OperationType   pOperationType,
+                               Symbol          pEntity,
+                               bool*           pIsKeyTaken)
+{
+    TRACE(2, "DoLog::sqlOperation");
+
+    // create new or reuse existing batch
+    Batch* batch = findBatch(pBatchKey);
+    if (!batch)
+    { // new operation for a given key
+        batch = addBatch(pBatchKey);
+        if (pIsKeyTaken)
+        {
+            *pIsKeyTaken = true;
+        }
+    }
+
+    return sqlOperation(batch, pOperationType, pEntity);
+}
+
+// operations factory: produces operations stored in the batch
+Operation* DoLog::sqlOperation(Batch*        pBatch,
+                               OperationType pOperationType,
+                               Symbol        pEntity)
+{
+    TRACE(2, "DoLog::sqlOperation");
+
+    // always new operation to be produced by the factory upon call
+
+    TRACE_MSG(convertOperationType2string(pOperationType) + " -> " + pEntity.getName());
+    Operation* operation;
+    switch(pOperationType)
+    {
+        case INSERT:
+            operation = new OperationInsert(pEntity);
+            break;
+
+        case DELETE:
+            operation = new OperationDelete(pEntity);
+            break;
+
+        case UPDATE:
+            operation = new OperationUpdate(pEntity);
+            break;
+
+        case SELECT:
+            operation = new OperationSelect(pEntity);
+            break;
+
+        default: throw invalid_argument("Wrong operation type, only INSERT, DELETE, UPDATE, SELECT allowed");
+    }
+
+    // the operations must be kept sorted by priority of the entities
+    pBatch->addOperation(operation, pOperationType, pEntity);
+
+    // linking the operation with it's batch (usefull in search for own operations)
+    operation->setBatch(pBatch);
+
+    return operation;
+}
+
+// batches loaded from now on are handed over to the callback one by one
+// instead of being kept in the context
+void DoLog::setBatchCallback(BatchCallback pCallback,
+                             void*         pUserData)
+{
+    mBatchCallback = pCallback;
+    mBatchCallbackData = pUserData;
+}
+
+// the loader parsed the whole batch with the key: without callback it is
+// kept, otherwise it is consumed by the callback and released at once; when no
+// other batch is kept the arena is rewound so the load runs in the memory
+// of one batch
+void DoLog::batchLoaded(ColumnValueSet* pBatchKey)
+{
+    TRACE(2, "DoLog::batchLoaded");
+
+    // no operation was registered with the key
+    if (!pBatchKey || pBatchKey != mLastBatchKey)
+    {
+        return;
+    }
+
+    // the key not taken over by the batch is released by the parser
+    if (!mBatchCallback)
+    {
+        mLastBatchKey = NULL;
+        mLastBatch = NULL;
+        return;
+    }
+
+    Batch* batch = mLastBatch;
+    TRACE_MSG("Batch loaded: " + batch->getDigest());
+    mBatchCallback(batch, mBatchCallbackData);
+
+    BatchContainerIt it = find(mBatchContainer.begin(), mBatchContainer.end(), batch);
+    if (it != mBatchContainer.end())
+    {
+        mBatchContainer.erase(it);
+    }
+    mBatchDigestIndex.erase(batch->getDigest());
+    mLastBatchKey = NULL;
+    mLastBatch = NULL;
+    delete batch;
+
+    if (mBatchContainer.empty())
+    {
+        releaseBatches(mBatchContainer, mArena);
+    }
+}
+
+// get  the XML image of REDO operations for all batch containers registered
+string DoLog::getXmlRedo()
+{
+    TRACE(1, "DoLog::getXmlRedo");
+
+    XmlMemorySink sink;
+    writeXmlRedo(sink);
+
+    return sink.str();
+}
+
+// get the XML image of UNDO operations (transformation is done) for all batch containers registered
+string DoLog::getXmlUndo()
+{
+    TRACE(1, "DoLog::getXmlUndo");
+
+    XmlMemorySink sink;
+    writeXmlUndo(sink);
+
+    return sink.str();
+}
+
+// render the XML image of REDO operations for all batch containers registered
+void DoLog::writeXmlRedo(XmlSink& pSink)
+{
+    TRACE(1, "DoLog::writeXmlRedo");
+
+    pSink << "<REDOLOG>\n";
+    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    {
+        (*it)->writeXmlRedo(pSink);
+    }
+    pSink << "</REDOLOG>\n";
+}
+
+// render the XML image of UNDO operations for all batch containers registered
+void DoLog::writeXmlUndo(XmlSink& pSink)
+{
+    TRACE(1, "DoLog::writeXmlUndo");
+
+    if (mSpillFile && mFormat != UNDOLOG_FORMAT_XML)
+    {
+        throw(std::runtime_error("Spilled batches are not in XML format"));
+    }
+
+    pSink << "<UNDOLOG>\n";
+    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    {
+        if (mSpillFile)
+        {
+            writeUndoBatch(*it, pSink, mSpillFile, mSpillIndex);
+        }
+        else
+        {
+            (*it)->writeXmlUndo(pSink);
+        }
+    }
+    pSink << "</UNDOLOG>\n";
+}
+
+// execute all SQL statements from the container
+void DoLog::sqlStatementTextAll(StringVector& pSqlTextContainer)
+{
+    TRACE(1, "DoLog::sqlStatementTextAll");
+
+    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    {
+        Batch* batch = *it;
+        batch->sqlStatementTextAll(pSqlTextContainer);
+    }
+}
+
+// render the image of UNDO operations in the format set
+void DoLog::writeUndo(XmlSink& pSink)
+{
+    TRACE(1, "DoLog::writeUndo");
+
+    if (mFormat == UNDOLOG_FORMAT_XML)
+    {
+        writeXmlUndo(pSink);
+        return;
+    }
+
+    writeUndoHead(pSink);
+    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    {
+        writeUndoBatch(*it, pSink, mSpillFile, mSpillIndex);
+    }
+    writeUndoTail(pSink);
+}
+
+void DoLog::writeUndoHead(XmlSink& pSink)
+{
+    if (mFormat == UNDOLOG_FORMAT_XML)
+    {
+        pSink << "<UNDOLOG>\n";
+    }
+    else
+    {
+        BinaryWriter writer(pSink);
+        writer.writeHead();
+    }
+}
+
+void DoLog::writeUndoBatch(Batch*   pBatch,
+                           XmlSink& pSink)
+{
+    if (mFormat == UNDOLOG_FORMAT_XML)
+    {
+        pBatch->writeXmlUndo(pSink);
+    }
+    else
+    {
+        BinaryWriter writer(pSink);
+        pBatch->writeBinaryUndo(writer);
+    }
+}
+
+void DoLog::writeUndoTail(XmlSink& pSink)
+{
+    if (mFormat == UNDOLOG_FORMAT_XML)
+    {
+        pSink << "</UNDOLOG>\n";
+    }
+    else
+    {
+        BinaryWriter writer(pSink);
+        writer.writeTail();
+    }
+}
+
+// record of one batch key as stored in DB
+void DoLog::writeUndoRecord(Batch*      pBatch,
+                            XmlSink&    pSink,
+                            FILE*       pSpillFile,
+                            SpillIndex& pSpillIndex)
+{
+    writeUndoHead(pSink);
+    writeUndoBatch(pBatch, pSink, pSpillFile, pSpillIndex);
+    writeUndoTail(pSink);
+}
+
+// save all operations for all batches in one file, the image is streamed
+// directly into the file
+bool DoLog::save(const char* pFileName)
+{
+    TRACE(1, "DoLog::save");
 
+    ofstream output;
+    output.exceptions ( ofstream::failbit | ofstream::badbit );
     try
     {
-        ss << "<UNDOLOG>\n";
-        for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+        output.open (pFileName, ios::out | ios::binary);
+        XmlFileSink sink(output);
+        writeUndo(sink);
+        output.close();
+    }
+    catch (ofstream::failure& e)
+    {
+        return ERROR("Exception handling file: " + string(pFileName) + ", " + string(e.what()));
+    }
+    catch (exception &e)
+    {
+        return ERROR("Exception caught while building XML: " + string(e.what()));
+    }
+
+    return true;
+}
+
+
+// save each batch to DB in a separate block, the image is rendered directly
+// into the host variable used by the INSERT
+bool DoLog::save()
+{
+    return save(mBatchContainer, mSpillFile, mSpillIndex);
+}
+
+// one record for each batch, the parts of it spilled before are merged
+// into the record
+bool DoLog::save(BatchContainer& pBatchContainer,
+                 FILE*           pSpillFile,
+                 SpillIndex&     pSpillIndex)
+{
+    TRACE(1, "DoLog::save");
+
+    // DB operation status
+    bool ok;
+    // key values for the materialized XML record
+    string customerId;
+    string billSeqNo;
+
+    // sequence usage statistics are kept per flush
+    mSeqNoFetchCount = 0;
+    mSeqNoKeyCount = 0;
+
+    for(BatchContainerIt it = pBatchContainer.begin(); it != pBatchContainer.end(); ++it)
+    {
+        Batch* batch = *it;
+        bool isInArraySlot = false;
+        size_t imageLength = 0;
+
+        try
+        {
+            // array mode: the image goes to the next slot of the array INSERT,
+            // only the images not fitting into the slot go to the LONG VARCHAR
+            // buffer and they are inserted one by one
+            if (mInsertArraySize > 1)
+            {
+                char* slot = dbLongVarcharInsertArraySlot();
+                if (slot == NULL)
+                {
+                    dbInsertArrayRelease();
+                    return ERROR("Unable get array slot for XML record: " + batch->getDigest());
+                }
+
+                XmlFixedSink slotImage(slot, MAX_XML_ARRAY_SLOT_SIZE);
+                writeUndoRecord(batch, slotImage, pSpillFile, pSpillIndex);
+                if (!slotImage.isOverflow())
+                {
+                    isInArraySlot = true;
+                    imageLength = slotImage.length();
+                }
+            }
+
+            if (!isInArraySlot)
+            {
+                mImage.clear();
+                writeUndoRecord(batch, mImage, pSpillFile, pSpillIndex);
+                imageLength = mImage.length();
+            }
+        }
+        catch (exception &e)
+        {
+            dbInsertArrayRelease();
+            return ERROR("Exception caught while building XML, " + string(e.what()));
+        }
+
+        if (imageLength > mImageHighWaterMark)
+        {
+            mImageHighWaterMark = imageLength;
+        }
+
+        // optional values: may be not used in the key
+        // in this case the empty string is returned
+        customerId = batch->mBatchKey->findValueByLabel("CUSTOMER_ID");
+        billSeqNo = batch->mBatchKey->findValueByLabel("BILLSEQNO");
+
+        if (isInArraySlot)
+        {
+            ok = dbLongVarcharInsertArrayAdd(imageLength,
+                                             batch->getDigest(),
+                                             customerId,
+                                             billSeqNo);
+        }
+        else
+        {
+            ok = dbLongVarcharInsert(mImage,
+                                     batch->getDigest(),
+                                     customerId,
+                                     billSeqNo);
+        }
+        if (!ok)
+        {
+            // records collected so far must not be inserted with next flush
+            dbInsertArrayRelease();
+            return ERROR("Error inserting XML record: " + batch->getDigest());
+        }
+    }
+
+    // insert the rest of the records collected in the array
+    ok = dbLongVarcharInsertArrayFlush();
+    if (!ok)
+    {
+        return ERROR("Error inserting XML records with array INSERT");
+    }
+
+    TRACE_MSG("Sequence round trips: " + any2string(mSeqNoFetchCount)
+              + ", saved: " + any2string(getSeqNoRoundTripsSaved()));
+    TRACE_MSG("XML image high water mark: " + any2string(mImageHighWaterMark)
+              + ", LONG buffer size: " + any2string(mImage.capacity()));
+    TRACE_MSG("Arena used: " + any2string(mArena.getBytesUsed())
+              + ", reserved: " + any2string(mArena.getBytesReserved()));
+
+    return true;
+}
+
+// the batches with their arena are swapped with the empty second buffer
+// and saved by the writer thread, next flush waits for the previous one;
+// the writer has its own buffers and uses the connection of the context
+// only while the context does not use it
+FlushHandle* DoLog::saveAsync()
+{
+    TRACE(1, "DoLog::saveAsync");
+
+    mFlush.wait();
+
+    if (!mFlush.mWriter)
+    {
+        mFlush.mWriter = new DoLog;
+    }
+    DoLog* writer = mFlush.mWriter;
+    free(writer->mDbHandle);
+    writer->mDbHandle = strdup(mDbHandle);
+    writer->mDbUserName = mDbUserName;
+    writer->mHandleDbConnect = mHandleDbConnect;
+    writer->mSqlContext = mSqlContext;
+    writer->mFormat = mFormat;
+    if (writer->mInsertArraySize != mInsertArraySize)
+    {
+        writer->dbInsertArrayRelease();
+        writer->mInsertArraySize = mInsertArraySize;
+    }
+
+    // the batches of all shards are collected into the context first, the
+    // writer gets them all upon swap
+    if (mBatchStore)
+    {
+        mBatchStore->collect(mBatchContainer);
+    }
+    TRACE_MSG("Batches handed over to writer: " + any2string(mBatchContainer.size()));
+    mFlush.mBatchContainer.swap(mBatchContainer);
+    mFlush.mArena.swap(mArena);
+    mFlush.mSpillFile = mSpillFile;
+    mFlush.mSpillIndex.swap(mSpillIndex);
+    mSpillFile = NULL;
+    mSpillCount = 0;
+    mBatchIndex.clear();
+    mBatchDigestIndex.clear();
+    mLastBatchKey = NULL;
+    mLastBatch = NULL;
+
+    // the connection of the caller may be used by the caller at any time
+    mFlush.mIsSaved = false;
+    if (!mHandleDbConnect)
+    {
+        TRACE_MSG("Connection not opened by the library, saving synchronously");
+        FlushHandle::start(&mFlush);
+        mFlush.collectStatistics();
+    }
+    else if (pthread_create(&mFlush.mThread, NULL, FlushHandle::start, &mFlush) != 0)
+    {
+        TRACE_MSG("Writer thread not started, saving synchronously");
+        FlushHandle::start(&mFlush);
+        mFlush.collectStatistics();
+    }
+    else
+    {
+        mFlush.mIsPending = true;
+    }
+
+    return &mFlush;
+}
+
+// commit of the connection opened by logUndoInit
+void DoLog::commit()
+{
+    TRACE(1, "DoLog::commit");
+
+    if (mHandleDbConnect && dbCommit())
+    {
+        TRACE_MSG("Commit done on DB connection " + string(mDbHandle));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Spill of batches: the BATCH element of each batch is rendered into the
+// temporary file, the images are indexed by digest of the batch. The batch
+// stays in memory with its key and SELECT values only; all the images of
+// the key are merged into its record upon save.
+////////////////////////////////////////////////////////////////////////////////
+
+// the image is copied to the sink in pieces
+static bool spillCopy(FILE*    pFile,
+                      size_t   pLength,
+                      XmlSink& pSink)
+{
+    char buffer[8192];
+    while (pLength > 0)
+    {
+        size_t length = pLength < sizeof(buffer) ? pLength : sizeof(buffer);
+        if (fread(buffer, length, 1, pFile) != 1)
+        {
+            return false;
+        }
+        pSink.write(buffer, length);
+        pLength -= length;
+    }
+
+    return true;
+}
+
+// values of the key of logUndoBatch
+static bool batchKeyOf(Batch* pBatch,
+                       int&   pCustomerId,
+                       int&   pBillSeqNo)
+{
+    ColumnValueSet* key = pBatch->getBatchKey();
+    SqlValue* customerId = key->findSqlValueByLabel(customerIdLabel());
+    SqlValue* billSeqNo = key->findSqlValueByLabel(billSeqNoLabel());
+    if (!customerId || !billSeqNo)
+    {
+        return false;
+    }
+
+    pCustomerId = any2int(customerId->getValue());
+    pBillSeqNo = any2int(billSeqNo->getValue());
+
+    return true;
+}
+
+// the memory of batches is measured by their arena
+bool DoLog::isOverBudget()
+{
+    return mMemoryBudget > 0 &&
+           !mBatchStore &&
+           mArena.getBytesUsed() > mMemoryBudget;
+}
+
+// all batches rendered into the file and released, the file is truncated
+// back if it could not be written so the batches stay in memory; each batch
+// is replaced by the copy of its key and SELECT values so the key may be
+// used again
+bool DoLog::spill()
+{
+    TRACE(1, "DoLog::spill");
+
+    if (!mSpillFile)
+    {
+        mSpillFile = tmpfile();
+        if (!mSpillFile)
+        {
+            return ERROR("Unable create temporary file for spill of batches");
+        }
+    }
+
+    fseek(mSpillFile, 0, SEEK_END);
+    long start = ftell(mSpillFile);
+    SpillSegmentContainer segment;
+    SpillSegment part = { start, 0 };
+    bool ok = true;
+    for(BatchContainerIt it = mBatchContainer.begin(); ok && it != mBatchContainer.end(); ++it)
+    {
+        // the batch kept only for its SELECT values has no image
+        mSpillImage.clear();
+        if ((*it)->hasUndo())
+        {
+            writeUndoBatch(*it, mSpillImage);
+        }
+        part.offset += part.length;
+        part.length = mSpillImage.length();
+        segment.push_back(part);
+        ok = part.length == 0 || fwrite(mSpillImage.data(), part.length, 1, mSpillFile) == 1;
+    }
+
+    // the copies are built in separate arena, taken over by the arena
+    // of the context when the batches are released
+    Arena retainedArena;
+    BatchContainer retained;
+    Arena* current = Arena::getCurrent();
+    if (ok)
+    {
+        Arena::setCurrent(&retainedArena);
+        try
+        {
+            for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+            {
+                retained.push_back(retainBatch(*it));
+            }
+        }
+        catch (exception &e)
+        {
+            ERROR("Exception caught while keeping batch keys, " + string(e.what()));
+            releaseBatches(retained, retainedArena);
+            ok = false;
+        }
+        Arena::setCurrent(current);
+    }
+
+    if (!ok || fflush(mSpillFile) != 0)
+    {
+        // the copies made before a failed flush are not used
+        releaseBatches(retained, retainedArena);
+        fflush(mSpillFile);
+        if (ftruncate(fileno(mSpillFile), start) != 0)
+        {
+            return ERROR("Unable truncate spill file after failed write");
+        }
+        fseek(mSpillFile, start, SEEK_SET);
+        return ERROR("Unable write batches to spill file, kept in memory");
+    }
+
+    mSpillCount += mBatchContainer.size();
+    TRACE_MSG("Spilled batches: " + any2string(mBatchContainer.size())
+              + ", arena used: " + any2string(mArena.getBytesUsed()));
+
+    // the batches of logUndoBatch are found again by their key values,
+    // the other ones by digest
+    std::vector<bool> isIndexed;
+    std::vector<int> customerId(mBatchContainer.size());
+    std::vector<int> billSeqNo(mBatchContainer.size());
+    for (size_t i = 0; i < mBatchContainer.size(); i++)
+    {
+        Batch* batch = mBatchContainer[i];
+        if (segment[i].length > 0)
+        {
+            mSpillIndex[batch->getDigest()].push_back(segment[i]);
+        }
+        isIndexed.push_back(batchKeyOf(batch, customerId[i], billSeqNo[i]) &&
+                            findBatch(customerId[i], billSeqNo[i]) == batch);
+    }
+
+    // the memory is released but not the spill file
+    releaseBatches(mBatchContainer, mArena);
+    mArena.adopt(retainedArena);
+    mBatchContainer.swap(retained);
+    mBatchIndex.clear();
+    mBatchDigestIndex.clear();
+    mLastBatchKey = NULL;
+    mLastBatch = NULL;
+    mCurrentBatch = NULL;
+
+    for (size_t i = 0; i < mBatchContainer.size(); i++)
+    {
+        Batch* batch = mBatchContainer[i];
+        if (isIndexed[i])
+        {
+            mBatchIndex.insert(customerId[i], billSeqNo[i], batch);
+        }
+        else
+        {
+            mBatchDigestIndex.insert(pair<string, Batch*>(batch->getDigest(), batch));
+        }
+    }
+
+    return true;
+}
+
+// copy of the key of the batch and of the first SELECT of each entity, the
+// UPDATE registered after spill takes the values before from the SELECT
+Batch* DoLog::retainBatch(Batch* pBatch)
+{
+    ColumnValueSet* key = new ColumnValueSet;
+    *key = *pBatch->mBatchKey;
+    Batch* batch = new Batch(key);
+
+    for (OperationIndexIt it = pBatch->mFirstOperation.begin(); it != pBatch->mFirstOperation.end(); ++it)
+    {
+        if (it->first.first != SELECT)
+        {
+            continue;
+        }
+
+        Operation* select = it->second;
+        ColumnValueSet keySet;
+        ColumnValueSet valueSet;
+        keySet = *select->getKeySet();
+        valueSet = *select->getValueSet();
+        Operation* operation = sqlOperation(batch, SELECT, select->getEntity());
+        operation->addKeySet(&keySet);
+        operation->addValueSet(&valueSet, NULL);
+    }
+
+    return batch;
+}
+
+// the batch and the images spilled for its key before, the latest first as
+// all in UNDO order; the BATCH elements are merged into one batch upon load
+void DoLog::writeUndoBatch(Batch*      pBatch,
+                           XmlSink&    pSink,
+                           FILE*       pSpillFile,
+                           SpillIndex& pSpillIndex)
+{
+    SpillIndex::iterator it = pSpillIndex.end();
+    if (pSpillFile)
+    {
+        it = pSpillIndex.find(pBatch->getDigest());
+    }
+
+    if (it == pSpillIndex.end())
+    {
+        writeUndoBatch(pBatch, pSink);
+        return;
+    }
+
+    // the batch kept only for its SELECT values has nothing to undo
+    if (pBatch->hasUndo())
+    {
+        writeUndoBatch(pBatch, pSink);
+    }
+
+    SpillSegmentContainer& segment = it->second;
+    for (SpillSegmentContainer::reverse_iterator part = segment.rbegin(); part != segment.rend(); ++part)
+    {
+        if (fseek(pSpillFile, part->offset, SEEK_SET) != 0 ||
+            !spillCopy(pSpillFile, part->length, pSink))
+        {
+            throw(std::runtime_error("Unable read spill file"));
+        }
+    }
+}
+
+// number of keys assigned in the last flush without own sequence round trip
+int DoLog::getSeqNoRoundTripsSaved()
+{
+    return mSeqNoKeyCount - mSeqNoFetchCount;
+}
+
+// length of the biggest XML record rendered by the process
+size_t DoLog::getImageHighWaterMark()
+{
+    return mImageHighWaterMark;
+}
+
+// max memory used by the batches between two flushes
+size_t DoLog::getArenaHighWaterMark()
+{
+    return mArenaHighWaterMark;
+}
+
+// load XML from file
+bool DoLog::load(const char* pFileName)
+{
+    TRACE(1, "DoLog::load" );
+
+    // the file is mapped read only and parsed in place, the pages are
+    // read by the kernel upon access
+    int fd = open(pFileName, O_RDONLY);
+    if (fd < 0)
+    {
+        return ERROR("Unable open file: " + string(pFileName) + ", " + string(strerror(errno)));
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        return ERROR("Unable stat file: " + string(pFileName) + ", " + string(strerror(errno)));
+    }
+
+    size_t length = status.st_size;
+    void* image = NULL;
+    if (length > 0)
+    {
+        image = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (image == MAP_FAILED)
         {
-            Batch* batch = it->second;
-            ss << "<BATCH>\n";
-            ss << "<DIGEST>" << it->first << "</DIGEST>\n";
-            ss << "<KEY>\n";
-            ss << batch->mBatchKey->getXml();
-            ss << "</KEY>\n";
-            ss << batch->getXmlUndo();
-            ss << "</BATCH>\n";
+            close(fd);
+            return ERROR("Unable map file: " + string(pFileName) + ", " + string(strerror(errno)));
         }
-        ss << "</UNDOLOG>\n";
+        madvise(image, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+
+    bool ok = true;
+    try
+    {
+        parse(image ? (const unsigned char *)image : (const unsigned char *)"", length);
     }
     catch (exception &e)
     {
-        return ERROR("Exception caught while building XML: " + string(e.what()));
+        ok = ERROR("Exception parsing XML: " + string(e.what()));
+    }
+    catch (...)
+    {
+        ok = ERROR("Exception parsing XML");
+    }
+
+    if (image)
+    {
+        munmap(image, length);
     }
 
-    ofstream output;
-    output.exceptions ( ofstream::failbit | ofstream::badbit );
+    return ok;
+}
+
+// parse of the record loaded from DB, the error is returned as message
+string DoLog::parseRecord(const unsigned char* pBuffer,
+                          const size_t         pBufferLength)
+{
+    TRACE(3, "DoLog::parseRecord");
+
     try
     {
-        output.open (pFileName);
-        output << ss.str();
-        output.close();
+        parse(pBuffer, pBufferLength);
     }
-    catch (ofstream::failure& e)
+    catch(std::runtime_error &e)
     {
-        return ERROR("Exception handling file: " + string(pFileName) + ", " + string(e.what()));
+        return "Error parsing XML: " + string(e.what());
+    }
+    catch(...)
+    {
+        return "Unknown exception while parsing XML";
     }
 
-    return true;
+    return string();
 }
 
-// save each batch to DB in a separate block
-bool DoLog::save()
+// batches parsed elsewhere are taken over, the operations of a batch with
+// key already known are appended to the batch found
+void DoLog::mergeBatches(BatchContainer& pBatchContainer)
 {
-    TRACE(1, "DoLog::save");
-
-    // DB operation status
-    bool ok;
-    // key values for the materialized XML record
-    string customerId;
-    string billSeqNo;
-    string image;
+    TRACE(3, "DoLog::mergeBatches");
 
-    for(BatchContainerIt it = mBatchContainer.begin(); it != mBatchContainer.end(); ++it)
+    for (BatchContainerIt it = pBatchContainer.begin(); it != pBatchContainer.end(); ++it)
     {
-        stringstream ss;
-        Batch* batch = it->second;
-
-        try
-        {
-            ss << "<UNDOLOG>\n";
-            ss << "<BATCH>\n";
-            ss << "<DIGEST>" << it->first << "</DIGEST>\n";
-            ss << "<KEY>\n";
-            ss << batch->mBatchKey->getXml();
-            ss << "</KEY>\n";
-            ss << batch->getXmlUndo();
-            ss << "</BATCH>\n";
-            ss << "</UNDOLOG>\n";
-
-            image = ss.str();
-        }
-        catch (exception &e)
+        Batch* batch = *it;
+        BatchDigestIndexIt found = mBatchDigestIndex.find(batch->getDigest());
+        if (found == mBatchDigestIndex.end())
         {
-            return ERROR("Exception caught while building XML, " + string(e.what()));
+            mBatchContainer.push_back(batch);
+            mBatchDigestIndex.insert(pair<string, Batch*>(batch->getDigest(), batch));
         }
-
-        // optional values: may be not used in the key
-        // in this case the empty string is returned
-        customerId = batch->mBatchKey->findValueByLabel("CUSTOMER_ID");
-        billSeqNo = batch->mBatchKey->findValueByLabel("BILLSEQNO");
-
-        ok = dbLongVarcharInsert(image,
-                                 batch->mDigest,
-                                 customerId,
-                                 billSeqNo);
-        if (!ok)
+        else
         {
-            return ERROR("Error inserting XML record: " + batch->mDigest);
+            found->second->append(*batch);
+            delete batch;
         }
     }
+    pBatchContainer.clear();
 
-    return true;
+    mLastBatchKey = NULL;
+    mLastBatch = NULL;
 }
 
-// load XML from file
-bool DoLog::load(const char* pFileName)
+// the format of the record is recognized by its first bytes; the keys of
+// the parser are gone after the parse, so is the last key resolved
+void DoLog::parse(const unsigned char* pBuffer,
+                  const size_t         pBufferLength)
 {
-    TRACE(1, "DoLog::load" );
-
-    stringstream ss;
-    ifstream input;
-    string s;
-
-    input.exceptions ( ifstream::failbit | ifstream::badbit );
-    try
-    {
-        input.open (pFileName);
-        ss << input.rdbuf();
-        input.close();
-    }
-    catch (ofstream::failure &e)
-    {
-        return ERROR("Exception handling file: " + string(pFileName) + ", " + string(e.what()));
-    }
-
-    s = ss.str();
     try
     {
-        xmlParse((unsigned char *)s.c_str(), (size_t)s.length());
-    }
-    catch (exception &e)
-    {
-        return ERROR("Exception parsing XML: " + string(e.what()));
+        if (isBinaryUndolog(pBuffer, pBufferLength))
+        {
+            binaryParse(pBuffer, pBufferLength);
+        }
+        else
+        {
+            xmlParse(pBuffer, pBufferLength);
+        }
     }
     catch (...)
     {
-        return ERROR("Exception parsing XML");
+        mLastBatchKey = NULL;
+        mLastBatch = NULL;
+        throw;
     }
 
-    return true;
+    mLastBatchKey = NULL;
+    mLastBatch = NULL;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1409,35 +3005,61 @@ void logUndoInit(const char* pDbName,
 {
     TRACE(2, "logUndoInit");
 
+    // each context of a thread uses its own connection id, the connection
+    // may be still used by the writer thread
+    DoLog* doLog = DoLog::getInstance();
+    doLog->mFlush.wait();
+    if (doLog->mIsSqlContextOwned)
+    {
+        doLog->dbRelease();
+    }
+    free(doLog->mDbHandle);
     if (pDbConnectionId == NULL)
     {
-        DoLog::getInstance()->mDbHandle = strdup("UNDO");
+        doLog->mDbHandle = strdup("UNDO");
     }
     else // requested specific connection id but not necessarilly standalone log in
     {
-        DoLog::getInstance()->mDbHandle = strdup(pDbConnectionId);
+        doLog->mDbHandle = strdup(pDbConnectionId);
     }
 
     // requested standlone connection
     if (pDbName != NULL)
     {
-        DoLog::getInstance()->mHandleDbConnect = true;
-        DoLog::getInstance()->mDbUserName = string(pDbUser);
-        sDbConnect.connect(pDbName,
-                           pDbUser,
-                           pDbPass,
-                           DoLog::getInstance()->mDbHandle);
-        TRACE_MSG("Connected to Oracle DB: " + string(pDbName));
+        doLog->mDbUserName = string(pDbUser);
+        if (doLog->dbConnect(pDbName,
+                             pDbUser,
+                             pDbPass))
+        {
+            TRACE_MSG("Connected to Oracle DB: " + string(pDbName));
+        }
     }
     else
     {
-        DoLog::getInstance()->mHandleDbConnect = false;
+        doLog->mHandleDbConnect = false;
     }
 
     // requested specific log level, default value 0
     Trace::setLevel(pLogLevel);
 }
 
+//
+// Runtime context of the connection opened by the caller
+//
+
+void logUndoDbContext(void* pSqlContext)
+{
+    TRACE(2, "logUndoDbContext");
+
+    DoLog* doLog = DoLog::getInstance();
+    if (doLog->mIsSqlContextOwned)
+    {
+        throw(invalid_argument("Context uses its own DB connection"));
+    }
+
+    doLog->mSqlContext = pSqlContext;
+}
+
 //
 // Register new batch or use the existing one from the previously allocated batch
 //
@@ -1447,27 +3069,67 @@ void logUndoBatch(int pCustomerId,
 {
     TRACE(2, "logUndoBatch");
 
-    // build a key for parameters
-    ColumnValueSet* batchKey = new ColumnValueSet;
-    SqlValue* keyValueBillSeqNo = new SqlInteger("BILLSEQNO", pBillSeqNo);
-    batchKey->addValue(keyValueBillSeqNo);
-    SqlValue* keyValueCustomerId = new SqlInteger("CUSTOMER_ID", pCustomerId);
-    batchKey->addValue(keyValueCustomerId);
+    // try find batch by provided key (may be it will be previously used),
+    // the key values are built only for a new batch
+    DoLog* doLog = DoLog::getInstance();
+    if (doLog->mBatchStore)
+    {
+        doLog->useSharedBatch(pCustomerId, pBillSeqNo);
+        return;
+    }
+
+    // the operations registered so far go out of memory if the budget
+    // is exceeded, the keys and SELECT values of the batches stay
+    if (doLog->isOverBudget())
+    {
+        doLog->spill();
+    }
+
+    Batch* batch = doLog->findBatch(pCustomerId, pBillSeqNo);
+    if (!batch)
+    {
+        batch = doLog->addBatch(pCustomerId, pBillSeqNo);
+    }
+
+    // use the batch for all subsequent operations
+    doLog->mCurrentBatch = batch;
+}
+
+//
+// Capture contexts: by default each thread uses its own one created upon first
+// use, a context may be as well created and bound explicitly
+//
+
+DoLog* logUndoContextCreate(const int pShardCount)
+{
+    TRACE(2, "logUndoContextCreate");
 
-    // try find batch by provided key (may be it will be previously used)
-    string searchDigest = batchKey->getDigest();
-    ColumnValueSet* finding = DoLog::getInstance()->findBatchKey(searchDigest);
-    if (finding)
+    DoLog* context = new DoLog;
+    if (pShardCount > 0)
     {
-        // already there -> use its key for all subsequent operations
-        sLastBatchKey = finding;
-        delete batchKey;
+        context->mBatchStore = new BatchStore(pShardCount);
     }
-    else // not found -> create empty batch storing pointer to its key
+
+    return context;
+}
+
+DoLog* logUndoContextBind(DoLog* pContext)
+{
+    TRACE(2, "logUndoContextBind");
+
+    return DoLog::setInstance(pContext);
+}
+
+void logUndoContextDestroy(DoLog* pContext)
+{
+    TRACE(2, "logUndoContextDestroy");
+
+    if (pContext && pContext == DoLog::findInstance())
     {
-        Batch* batch = DoLog::getInstance()->addBatch(searchDigest, batchKey);
-        sLastBatchKey = batch->getBatchKey();
+        throw(invalid_argument("Context still bound to the thread"));
     }
+
+    delete pContext;
 }
 
 //
@@ -1601,14 +3263,6 @@ void logUndo(const OperationType pOperationType,
     }
     else // END state reached in arg list parsing
     {
-        // register operation with all required fields in the heap
-        // returnning pointer to allocated area
-        // REMARK: no need to release it here, it will happen in flush phase
-        if (!sLastBatchKey)
-        {
-            throw(invalid_argument("Batch not initialized"));
-        }
-
         if (!isUseKeyFound)
         {
             throw(invalid_argument("KEY section not defined"));
@@ -1619,8 +3273,9 @@ void logUndo(const OperationType pOperationType,
             throw(invalid_argument("VALUE section not defined"));
         }
 
-        Operation* operation = DoLog::getInstance()->sqlOperation(sLastBatchKey, pOperationType, pEntity);
-        operation->addKeySet(&keySet);
+        ColumnValueSet* valueBefore = NULL;
+        ColumnValueSet* valueAfter = NULL;
+
         //
         // Each operation on an entity has pecific mandatory value set:
         // 1. INSERT: PreOperationValue = NULL, PostOperationValue
@@ -1637,7 +3292,7 @@ void logUndo(const OperationType pOperationType,
                 }
                 else
                 {
-                    operation->addValueSet(NULL, &valueSetFirst);
+                    valueAfter = &valueSetFirst;
                 }
                 break;
 
@@ -1648,18 +3303,19 @@ void logUndo(const OperationType pOperationType,
                 }
                 else
                 {
-                    operation->addValueSet(&valueSetFirst, NULL);
+                    valueBefore = &valueSetFirst;
                 }
                 break;
 
             case UPDATE:
                 if (valueSectionCounter == 1) // only once VALUE used, SELECT mandatory
                 {
-                    operation->addValueSet(NULL, &valueSetFirst);
+                    valueAfter = &valueSetFirst;
                 }
                 else if (valueSectionCounter == 2) // VALUE used twice, SELECT optional
                 {
-                    operation->addValueSet(&valueSetFirst, &valueSetSecond);
+                    valueBefore = &valueSetFirst;
+                    valueAfter = &valueSetSecond;
                 }
                 else
                 {
@@ -1674,7 +3330,7 @@ void logUndo(const OperationType pOperationType,
                 }
                 else
                 {
-                    operation->addValueSet(&valueSetFirst, NULL);
+                    valueBefore = &valueSetFirst;
                 }
                 break;
 
@@ -1682,13 +3338,303 @@ void logUndo(const OperationType pOperationType,
                 throw(invalid_argument("Invalid type of operation"));
         }
 
+        logUndoValueSets(pOperationType, pEntity, keySet, valueBefore, valueAfter);
+
         TRACE_MSG("[" + any2string(argumentId) + "] "
                   + convertOperationType2string(pOperationType)
                   + "/"
                   + pEntity);
     }
 
-    // here happens automatic destruction of the key & value handlers
+    // here happens automatic destruction of the key & value handlers,
+    // the values were taken over by the operation so they are empty
+}
+
+// current batch of the context locked until the end of the scope
+class CurrentBatchLock
+{
+public:
+    CurrentBatchLock(DoLog* pLog) : mLog(pLog), mBatch(pLog->lockCurrentBatch()) {}
+    ~CurrentBatchLock() { if (mBatch) mLog->unlockCurrentBatch(); }
+    Batch* getBatch() { return mBatch; }
+private:
+    DoLog* mLog;
+    Batch* mBatch;
+};
+
+//
+// Register operation with the sets of values captured, the values are taken
+// over by the operation. Common part of variadic and template interface.
+//
+
+void logUndoValueSets(const OperationType pOperationType,
+                      Symbol              pEntity,
+                      ColumnValueSet&     pKeySet,
+                      ColumnValueSet*     pValueBefore,
+                      ColumnValueSet*     pValueAfter)
+{
+    // register operation with all required fields in the heap
+    // returnning pointer to allocated area
+    // REMARK: no need to release it here, it will happen in flush phase
+    DoLog* doLog = DoLog::getInstance();
+    CurrentBatchLock batch(doLog);
+    if (!batch.getBatch())
+    {
+        throw(invalid_argument("Batch not initialized"));
+    }
+
+    Operation* operation = doLog->sqlOperation(batch.getBatch(), pOperationType, pEntity);
+    operation->addKeySet(&pKeySet);
+    operation->addValueSet(pValueBefore, pValueAfter);
+}
+
+//
+// Register row descriptor, it is kept until the end of the process
+//
+
+int logUndoRowDescriptor(const char*      pEntity,
+                         const RowColumn* pColumn,
+                         const int        pColumnCount)
+{
+    TRACE(2, "logUndoRowDescriptor");
+
+    if (!pEntity || !pColumn || pColumnCount <= 0)
+    {
+        throw(invalid_argument("Missing entity or columns of row descriptor"));
+    }
+
+    RowDescriptor* descriptor = new RowDescriptor(pEntity, pColumn, pColumnCount);
+
+    pthread_mutex_lock(&sRowDescriptorMutex);
+    int id = sRowDescriptorCount;
+    if (id == MAX_ROW_DESCRIPTOR)
+    {
+        pthread_mutex_unlock(&sRowDescriptorMutex);
+        delete descriptor;
+        throw(invalid_argument("Too many row descriptors: " + any2string(id)));
+    }
+
+    // the descriptor is visible to other threads before the count
+    sRowDescriptor[id] = descriptor;
+    __sync_synchronize();
+    sRowDescriptorCount = id + 1;
+    pthread_mutex_unlock(&sRowDescriptorMutex);
+
+    return id;
+}
+
+static RowDescriptor* rowDescriptor(const int pRowDescriptorId)
+{
+    if (pRowDescriptorId < 0 || pRowDescriptorId >= sRowDescriptorCount)
+    {
+        throw(invalid_argument("Invalid row descriptor id: " + any2string(pRowDescriptorId)));
+    }
+
+    return sRowDescriptor[pRowDescriptorId];
+}
+
+//
+// Capture the rows from host array of structs using its descriptor
+//
+
+void logUndoRows(const OperationType pOperationType,
+                 const int           pRowDescriptorId,
+                 const void*         pRows,
+                 const size_t        pRowSize,
+                 const int           pRowCount)
+{
+    TRACE(2, "logUndoRows");
+
+    RowDescriptor* descriptor = rowDescriptor(pRowDescriptorId);
+    if (!pRows || pRowCount < 0 || (pRowCount > 1 && pRowSize == 0))
+    {
+        throw(invalid_argument("Missing rows"));
+    }
+
+    // the rows must not overlap
+    if (pRowCount > 1 && pRowSize < descriptor->getRowExtent())
+    {
+        throw(invalid_argument("Row size " + any2string(pRowSize) +
+                               " smaller than row descriptor extent " +
+                               any2string(descriptor->getRowExtent())));
+    }
+
+    DoLog* doLog = DoLog::getInstance();
+    CurrentBatchLock batch(doLog);
+    if (!batch.getBatch())
+    {
+        throw(invalid_argument("Batch not initialized"));
+    }
+
+    // the single VALUE section is the value before for DELETE and SELECT
+    bool isValueBefore = (pOperationType == DELETE ||
+                          pOperationType == SELECT);
+
+    // the operations are registered directly in the batch, their values
+    // are allocated one after another in the arena of the log
+    Symbol entity = descriptor->getEntity();
+    const char* row = (const char *)pRows;
+    ColumnValueSet keySet;
+    ColumnValueSet valueSet;
+    for (int i = 0; i < pRowCount; i++, row += pRowSize)
+    {
+        descriptor->getKeySet(row, keySet);
+        descriptor->getValueSet(row, valueSet);
+        Operation* operation = doLog->sqlOperation(batch.getBatch(), pOperationType, entity);
+        operation->addKeySet(&keySet);
+        if (isValueBefore)
+        {
+            operation->addValueSet(&valueSet, NULL);
+        }
+        else
+        {
+            operation->addValueSet(NULL, &valueSet);
+        }
+    }
+}
+
+//
+// Capture the row from host struct using its descriptor
+//
+
+void logUndoRow(const OperationType pOperationType,
+                const int           pRowDescriptorId,
+                const void*         pRow)
+{
+    TRACE(2, "logUndoRow");
+
+    logUndoRows(pOperationType, pRowDescriptorId, pRow, 0, 1);
+}
+
+void logUndoRow(const OperationType pOperationType,
+                const int           pRowDescriptorId,
+                const void*         pRowBefore,
+                const void*         pRowAfter)
+{
+    TRACE(2, "logUndoRow");
+
+    RowDescriptor* descriptor = rowDescriptor(pRowDescriptorId);
+    if (pOperationType != UPDATE)
+    {
+        throw(invalid_argument("VALUE section used too many times or incorrectly"));
+    }
+
+    if (!pRowBefore || !pRowAfter)
+    {
+        throw(invalid_argument("Missing row"));
+    }
+
+    // the key is taken from the row after the operation
+    ColumnValueSet keySet;
+    ColumnValueSet valueBefore;
+    ColumnValueSet valueAfter;
+    descriptor->getKeySet(pRowAfter, keySet);
+    descriptor->getValueSet(pRowBefore, valueBefore);
+    descriptor->getValueSet(pRowAfter, valueAfter);
+    logUndoValueSets(pOperationType, descriptor->getEntity(), keySet, &valueBefore, &valueAfter);
+}
+
+//
+// Set the number of XML records inserted with one array INSERT upon flush.
+// The value is limited to MAX_INSERT_ARRAY_SIZE, the value 1 switches the
+// array mode off and each record is inserted with a separate statement.
+//
+
+void logUndoInsertArraySize(const int pArraySize)
+{
+    TRACE(2, "logUndoInsertArraySize");
+
+    int arraySize = pArraySize;
+    if (arraySize < 1)
+    {
+        arraySize = 1;
+    }
+    else if (arraySize > MAX_INSERT_ARRAY_SIZE)
+    {
+        arraySize = MAX_INSERT_ARRAY_SIZE;
+    }
+
+    // host arrays allocated for previous size are not usable any more,
+    // they may be still used by the writer thread
+    if (arraySize != DoLog::getInstance()->mInsertArraySize)
+    {
+        DoLog::getInstance()->mFlush.wait();
+        DoLog::getInstance()->dbInsertArrayRelease();
+        DoLog::getInstance()->mInsertArraySize = arraySize;
+    }
+
+    TRACE_MSG("Insert array size: " + any2string(arraySize));
+}
+
+//
+// Set memory budget of the context for the batches, 0 - no limit
+//
+
+void logUndoMemoryBudget(const size_t pBytes)
+{
+    TRACE(2, "logUndoMemoryBudget");
+
+    DoLog::getInstance()->mMemoryBudget = pBytes;
+    TRACE_MSG("Memory budget: " + any2string(pBytes));
+}
+
+//
+// Set format of the records saved by the context
+//
+
+void logUndoFormat(const UndologFormat pFormat)
+{
+    TRACE(2, "logUndoFormat");
+
+    if (pFormat != UNDOLOG_FORMAT_XML && pFormat != UNDOLOG_FORMAT_BINARY)
+    {
+        throw(invalid_argument("Invalid UNDOLOG format: " + any2string((int)pFormat)));
+    }
+
+    DoLog* doLog = DoLog::getInstance();
+    if (!doLog->mBatchContainer.empty() || doLog->mSpillFile)
+    {
+        throw(invalid_argument("UNDOLOG format changed with batches registered"));
+    }
+
+    doLog->mFormat = pFormat;
+}
+
+//
+// Set parser of the XML records loaded by the context
+//
+
+void logUndoXmlParser(const XmlParserType pParser)
+{
+    TRACE(2, "logUndoXmlParser");
+
+    if (pParser != XML_PARSER_XERCES && pParser != XML_PARSER_DEDICATED)
+    {
+        throw(invalid_argument("Invalid XML parser: " + any2string((int)pParser)));
+    }
+
+    DoLog::getInstance()->mXmlParser = pParser;
+}
+
+//
+// Set the number of parser threads used by load from DB
+//
+
+void logUndoLoadWorkers(const int pWorkerCount)
+{
+    TRACE(2, "logUndoLoadWorkers");
+
+    int workerCount = pWorkerCount;
+    if (workerCount < 1)
+    {
+        workerCount = 1;
+    }
+    else if (workerCount > MAX_LOAD_WORKER_COUNT)
+    {
+        workerCount = MAX_LOAD_WORKER_COUNT;
+    }
+
+    DoLog::getInstance()->mLoadWorkerCount = workerCount;
 }
 
 //
@@ -1700,18 +3646,53 @@ void logUndoFlush()
 {
     TRACE(2, "logUndoFlush");
 
-    DoLog::getInstance()->save();
-    DoLog::getInstance()->clean();
+    // only the context of the calling thread is saved, the shared context
+    // is saved with batches of all its threads taken at once
+    DoLog* doLog = DoLog::getInstance();
+    MutexLock lock(doLog->mBatchStore ? doLog->mBatchStore->getFlushMutex() : NULL);
+    doLog->mFlush.wait();
+    if (doLog->mBatchStore)
+    {
+        doLog->mBatchStore->collect(doLog->mBatchContainer);
+    }
+    doLog->save();
+    doLog->clean();
 
     // the user handles commit point
-    if (DoLog::getInstance()->mHandleDbConnect)
+    doLog->commit();
+
+    // no batch to process via variadic function
+    doLog->mCurrentBatch = NULL;
+}
+
+//
+// Flush in background: the batches are saved and committed by the writer thread
+//
+
+FlushHandle* logUndoFlushAsync()
+{
+    TRACE(2, "logUndoFlushAsync");
+
+    DoLog* doLog = DoLog::getInstance();
+    MutexLock lock(doLog->mBatchStore ? doLog->mBatchStore->getFlushMutex() : NULL);
+    FlushHandle* handle = doLog->saveAsync();
+
+    // no batch to process via variadic function
+    doLog->mCurrentBatch = NULL;
+
+    return handle;
+}
+
+bool logUndoFlushWait(FlushHandle* pHandle)
+{
+    TRACE(2, "logUndoFlushWait");
+
+    if (!pHandle)
     {
-        sDbConnect.commit();
-        TRACE_MSG("Commit done on DB connection " + string(DoLog::getInstance()->mDbHandle));
+        throw(invalid_argument("Missing flush handle"));
     }
 
-    // no batch to process via variadic function
-    sLastBatchKey = NULL;
+    return pHandle->wait();
 }
 
 }
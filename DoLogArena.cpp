@@ -0,0 +1,289 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogArena.cpp
+// Description: Implementation of monotonic memory arena used for the objects
+//              of the log released all together upon flush.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-09
+// Abstract   : Implementation of monotonic memory arena.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#include <new>
+#include <algorithm>
+
+#include <stdlib.h>
+
+#include "DoLogArena.hpp"
+
+namespace dolog
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// ArenaChunk, block header
+////////////////////////////////////////////////////////////////////////////////
+
+// all blocks are aligned to the size of the header
+union ArenaHeader
+{
+    Arena* arena;    // NULL - block from heap
+    double align;
+};
+
+struct ArenaChunk
+{
+    ArenaChunk* next;
+    size_t      size;  // usable size
+    size_t      used;
+    ArenaHeader data[1];
+};
+
+static size_t arenaAlign(size_t pSize)
+{
+    return (pSize + sizeof(ArenaHeader) - 1) & ~(sizeof(ArenaHeader) - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Arena
+////////////////////////////////////////////////////////////////////////////////
+
+__thread Arena* Arena::sCurrent = NULL;
+
+Arena::Arena(size_t pChunkSize)
+    : mFirst(NULL),
+      mCurrent(NULL),
+      mChunkSize(pChunkSize),
+      mBytesUsed(0)
+{}
+
+Arena::~Arena()
+{
+    ArenaChunk* chunk = mFirst;
+    while (chunk)
+    {
+        ArenaChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+
+    if (sCurrent == this)
+    {
+        sCurrent = NULL;
+    }
+}
+
+// new chunk is appended after the current one
+ArenaChunk* Arena::addChunk(size_t pSize)
+{
+    size_t size = pSize > mChunkSize ? pSize : mChunkSize;
+    ArenaChunk* chunk = (ArenaChunk *)malloc(sizeof(ArenaChunk) + size);
+    if (chunk == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    chunk->size = size;
+    chunk->used = 0;
+    if (mCurrent)
+    {
+        chunk->next = mCurrent->next;
+        mCurrent->next = chunk;
+    }
+    else
+    {
+        chunk->next = mFirst;
+        mFirst = chunk;
+    }
+
+    return chunk;
+}
+
+void* Arena::allocate(size_t pSize)
+{
+    size_t size = arenaAlign(pSize);
+
+    // the chunks kept upon rewind are used first
+    while (mCurrent == NULL || mCurrent->used + size > mCurrent->size)
+    {
+        ArenaChunk* next = mCurrent ? mCurrent->next : mFirst;
+        if (next == NULL || next->size < size)
+        {
+            next = addChunk(size);
+        }
+        mCurrent = next;
+        mCurrent->used = 0;
+    }
+
+    void* block = (char *)mCurrent->data + mCurrent->used;
+    mCurrent->used += size;
+    mBytesUsed += size;
+
+    return block;
+}
+
+// rewind: all memory is free again, only the first chunks are kept
+void Arena::reset()
+{
+    int kept = 0;
+    ArenaChunk* last = NULL;
+    ArenaChunk* chunk = mFirst;
+    while (chunk)
+    {
+        ArenaChunk* next = chunk->next;
+        if (kept < ARENA_KEEP_CHUNKS)
+        {
+            chunk->used = 0;
+            last = chunk;
+            kept++;
+        }
+        else
+        {
+            free(chunk);
+        }
+        chunk = next;
+    }
+
+    if (last)
+    {
+        last->next = NULL;
+    }
+
+    mCurrent = NULL;
+    mBytesUsed = 0;
+}
+
+// exchange of the memory, the blocks stay valid in the other arena
+void Arena::swap(Arena& rhs)
+{
+    std::swap(mFirst, rhs.mFirst);
+    std::swap(mCurrent, rhs.mCurrent);
+    std::swap(mChunkSize, rhs.mChunkSize);
+    std::swap(mBytesUsed, rhs.mBytesUsed);
+}
+
+// the memory used in the other arena is taken over, the blocks stay valid
+// and are released by rewind of this arena; the other arena keeps only its
+// chunks for reuse
+void Arena::adopt(Arena& rhs)
+{
+    if (rhs.mCurrent == NULL)
+    {
+        return;
+    }
+
+    // the chunks used in the other arena are placed in front of this arena
+    ArenaChunk* first = rhs.mFirst;
+    ArenaChunk* last = rhs.mCurrent;
+    rhs.mFirst = last->next;
+    rhs.mCurrent = NULL;
+
+    last->next = mFirst;
+    mFirst = first;
+    if (mCurrent == NULL)
+    {
+        // the next allocation continues in the last adopted chunk
+        mCurrent = last;
+    }
+    mBytesUsed += rhs.mBytesUsed;
+    rhs.mBytesUsed = 0;
+}
+
+size_t Arena::getBytesUsed()
+{
+    return mBytesUsed;
+}
+
+size_t Arena::getBytesReserved()
+{
+    size_t reserved = 0;
+    for (ArenaChunk* chunk = mFirst; chunk; chunk = chunk->next)
+    {
+        reserved += chunk->size;
+    }
+
+    return reserved;
+}
+
+Arena* Arena::getCurrent()
+{
+    return sCurrent;
+}
+
+void Arena::setCurrent(Arena* pArena)
+{
+    sCurrent = pArena;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// allocation with block header
+////////////////////////////////////////////////////////////////////////////////
+
+void* arenaAllocate(size_t pSize)
+{
+    Arena* arena = Arena::getCurrent();
+    ArenaHeader* header;
+
+    if (arena)
+    {
+        header = (ArenaHeader *)arena->allocate(sizeof(ArenaHeader) + pSize);
+    }
+    else
+    {
+        header = (ArenaHeader *)::operator new(sizeof(ArenaHeader) + pSize);
+    }
+    header->arena = arena;
+
+    return header + 1;
+}
+
+// arena blocks are released all together upon reset
+void arenaRelease(void* pBlock)
+{
+    if (pBlock)
+    {
+        ArenaHeader* header = (ArenaHeader *)pBlock - 1;
+        if (header->arena == NULL)
+        {
+            ::operator delete(header);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ArenaObject
+////////////////////////////////////////////////////////////////////////////////
+
+void* ArenaObject::operator new(size_t pSize)
+{
+    return arenaAllocate(pSize);
+}
+
+void ArenaObject::operator delete(void* pObject)
+{
+    arenaRelease(pObject);
+}
+
+}
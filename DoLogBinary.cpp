@@ -0,0 +1,555 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogBinary.cpp
+// Description: Implementation of compact binary encoding of UNDOLOG records
+//              and of the loader building the batches from binary record.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-23
+// Abstract   : Binary encoding of UNDOLOG records.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdexcept>
+
+#include <string.h>
+#include <stdint.h>
+
+#include "DoLogTerminationHandler.hpp"
+#include "DoLogComponentController.hpp"
+#include "DoLogTrace.hpp"
+#include "DoLogSqlValue.hpp"
+#include "DoLog.hpp"
+#include "DoLogBinary.hpp"
+
+using namespace std;
+
+namespace dolog
+{
+
+bool isBinaryUndolog(const unsigned char* pData,
+                     size_t               pLength)
+{
+    return pLength >= BINARY_MAGIC_LEN &&
+           memcmp(pData, BINARY_MAGIC, BINARY_MAGIC_LEN) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BinaryWriter
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryWriter::BinaryWriter(XmlSink& pSink) : mSink(pSink)
+{}
+
+void BinaryWriter::writeHead()
+{
+    mSink.write(BINARY_MAGIC, BINARY_MAGIC_LEN);
+    writeByte(BINARY_VERSION);
+}
+
+void BinaryWriter::writeTail()
+{
+    writeByte(BINARY_TAG_END);
+}
+
+// labels and entities are numbered again in each batch so that
+// the batches may be concatenated in any order
+void BinaryWriter::beginBatch()
+{
+    mSymbolIndex.clear();
+}
+
+void BinaryWriter::writeByte(unsigned char pValue)
+{
+    mSink.write((const char *)&pValue, 1);
+}
+
+void BinaryWriter::writeUnsigned(unsigned long pValue)
+{
+    char buffer[16];
+    size_t length = 0;
+    while (pValue >= 0x80)
+    {
+        buffer[length++] = (char)(pValue | 0x80);
+        pValue >>= 7;
+    }
+    buffer[length++] = (char)pValue;
+    mSink.write(buffer, length);
+}
+
+// small negative numbers are short as well
+void BinaryWriter::writeSigned(long pValue)
+{
+    unsigned long value = (unsigned long)pValue;
+    writeUnsigned((value << 1) ^ (pValue < 0 ? ~0UL : 0UL));
+}
+
+void BinaryWriter::writeFloat(float pValue)
+{
+    uint32_t bits;
+    memcpy(&bits, &pValue, sizeof(bits));
+    char buffer[4];
+    for (int i = 0; i < 4; i++)
+    {
+        buffer[i] = (char)(bits >> (8 * i));
+    }
+    mSink.write(buffer, sizeof(buffer));
+}
+
+void BinaryWriter::writeDouble(double pValue)
+{
+    uint64_t bits;
+    memcpy(&bits, &pValue, sizeof(bits));
+    char buffer[8];
+    for (int i = 0; i < 8; i++)
+    {
+        buffer[i] = (char)(bits >> (8 * i));
+    }
+    mSink.write(buffer, sizeof(buffer));
+}
+
+void BinaryWriter::writeString(const char* pData,
+                               size_t      pLength)
+{
+    writeUnsigned(pLength);
+    mSink.write(pData, pLength);
+}
+
+void BinaryWriter::writeString(const string& pValue)
+{
+    writeString(pValue.data(), pValue.size());
+}
+
+// the name is written upon first use in the batch, then only its index
+void BinaryWriter::writeSymbol(Symbol pSymbol)
+{
+    map<SymbolId, unsigned long>::iterator it = mSymbolIndex.find(pSymbol.getId());
+    if (it != mSymbolIndex.end())
+    {
+        writeUnsigned(it->second + 1);
+        return;
+    }
+
+    unsigned long index = mSymbolIndex.size();
+    mSymbolIndex.insert(pair<SymbolId, unsigned long>(pSymbol.getId(), index));
+    writeUnsigned(0);
+    writeString(pSymbol.getName());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// BinaryReader
+////////////////////////////////////////////////////////////////////////////////
+
+BinaryReader::BinaryReader(const unsigned char* pData,
+                           size_t               pLength)
+    : mData(pData),
+      mLength(pLength),
+      mPosition(0)
+{}
+
+void BinaryReader::need(size_t pLength)
+{
+    if (pLength > mLength - mPosition)
+    {
+        throw(std::runtime_error("Binary record truncated at position " + any2string(mPosition)));
+    }
+}
+
+void BinaryReader::readHead()
+{
+    if (!isBinaryUndolog(mData, mLength))
+    {
+        throw(std::runtime_error("Binary record magic not found"));
+    }
+    mPosition = BINARY_MAGIC_LEN;
+
+    int version = readByte();
+    if (version != BINARY_VERSION)
+    {
+        throw(std::runtime_error("Unsupported binary record version: " + any2string(version)));
+    }
+}
+
+void BinaryReader::beginBatch()
+{
+    mSymbol.clear();
+}
+
+unsigned char BinaryReader::readByte()
+{
+    need(1);
+    return mData[mPosition++];
+}
+
+unsigned long BinaryReader::readUnsigned()
+{
+    unsigned long value = 0;
+    for (unsigned int shift = 0; shift < 8 * sizeof(value); shift += 7)
+    {
+        unsigned char byte = readByte();
+        value |= (unsigned long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+
+    throw(std::runtime_error("Binary record number too long at position " + any2string(mPosition)));
+}
+
+long BinaryReader::readSigned()
+{
+    unsigned long value = readUnsigned();
+    return (long)(value >> 1) ^ -(long)(value & 1);
+}
+
+float BinaryReader::readFloat()
+{
+    need(4);
+    uint32_t bits = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        bits |= (uint32_t)mData[mPosition++] << (8 * i);
+    }
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+double BinaryReader::readDouble()
+{
+    need(8);
+    uint64_t bits = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        bits |= (uint64_t)mData[mPosition++] << (8 * i);
+    }
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+string BinaryReader::readString()
+{
+    unsigned long length = readUnsigned();
+    need(length);
+    string value((const char *)mData + mPosition, length);
+    mPosition += length;
+
+    return value;
+}
+
+Symbol BinaryReader::readSymbol()
+{
+    unsigned long index = readUnsigned();
+    if (index == 0)
+    {
+        unsigned long length = readUnsigned();
+        need(length);
+        Symbol symbol((const char *)mData + mPosition, length);
+        mPosition += length;
+        mSymbol.push_back(symbol);
+        return symbol;
+    }
+
+    if (index > mSymbol.size())
+    {
+        throw(std::runtime_error("Invalid symbol index in binary record: " + any2string(index)));
+    }
+
+    return mSymbol[index - 1];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// loading of binary record into the batches of the log
+////////////////////////////////////////////////////////////////////////////////
+
+typedef vector<pair<string, string> > AttributeContainer;
+
+// the value is built with the same type and native storage it was written with
+static SqlValue* readSqlValue(BinaryReader& pReader)
+{
+    SqlValueType typeId = (SqlValueType)pReader.readByte();
+    SqlValueStorage storage = (SqlValueStorage)pReader.readByte();
+    Symbol label = pReader.readSymbol();
+
+    AttributeContainer attribute;
+    string formatMask;
+    unsigned long count = pReader.readUnsigned();
+    for (unsigned long i = 0; i < count; i++)
+    {
+        string name = pReader.readString();
+        string value = pReader.readString();
+        if (name == "FormatMask")
+        {
+            formatMask = value;
+        }
+        attribute.push_back(pair<string, string>(name, value));
+    }
+
+    long number = 0;
+    float numberFloat = 0;
+    double numberDouble = 0;
+    string chars;
+    switch (storage)
+    {
+        case SQL_STORE_INT:
+        case SQL_STORE_SHORT:
+        case SQL_STORE_LONG:
+            number = pReader.readSigned();
+            break;
+
+        case SQL_STORE_FLOAT:
+            numberFloat = pReader.readFloat();
+            break;
+
+        case SQL_STORE_DOUBLE:
+            numberDouble = pReader.readDouble();
+            break;
+
+        case SQL_STORE_STRING:
+        case SQL_STORE_CHARS:
+            chars = pReader.readString();
+            break;
+
+        default:
+            throw(std::runtime_error("Invalid value storage in binary record: " + any2string((int)storage)));
+    }
+    bool isString = (storage == SQL_STORE_STRING || storage == SQL_STORE_CHARS);
+    bool isInteger = (storage == SQL_STORE_INT || storage == SQL_STORE_SHORT || storage == SQL_STORE_LONG);
+    bool isReal = (storage == SQL_STORE_FLOAT || storage == SQL_STORE_DOUBLE);
+
+    // the storage must be one the type is built with, otherwise the value
+    // would be read as zero
+    bool isMatch;
+    switch (typeId)
+    {
+        case SQL_INTEGER_TYPEID:
+        case SQL_SMALLINT_TYPEID:
+        case SQL_LONG_TYPEID:
+            isMatch = isString || isInteger;
+            break;
+
+        case SQL_FLOAT_TYPEID:
+        case SQL_DOUBLE_TYPEID:
+            isMatch = isString || isReal;
+            break;
+
+        case SQL_CHAR_TYPEID:
+        case SQL_DATE_TYPEID:
+        case SQL_VARCHAR_TYPEID:
+            isMatch = isString;
+            break;
+
+        default:
+            // rejected below
+            isMatch = true;
+            break;
+    }
+    if (!isMatch)
+    {
+        throw(std::runtime_error("Invalid value storage " + any2string((int)storage)
+                                 + " for TypeId " + any2string((int)typeId) + " in binary record"));
+    }
+
+    SqlValue* value = NULL;
+    switch (typeId)
+    {
+        case SQL_CHAR_TYPEID:
+            value = new SqlChar(label, chars);
+            break;
+
+        case SQL_INTEGER_TYPEID:
+            value = isString ? new SqlInteger(label, chars) : new SqlInteger(label, (int)number);
+            break;
+
+        case SQL_SMALLINT_TYPEID:
+            value = isString ? new SqlSmallint(label, chars) : new SqlSmallint(label, (short)number);
+            break;
+
+        // the double captured by reference is tagged as float, it is built
+        // the same way again
+        case SQL_FLOAT_TYPEID:
+            if (isString)
+            {
+                value = new SqlFloat(label, chars);
+            }
+            else if (storage == SQL_STORE_DOUBLE)
+            {
+                value = new SqlDouble(label, static_cast<void *>(&numberDouble));
+            }
+            else
+            {
+                value = new SqlFloat(label, numberFloat);
+            }
+            break;
+
+        case SQL_DOUBLE_TYPEID:
+            if (isString)
+            {
+                value = new SqlDouble(label, chars);
+            }
+            else if (storage == SQL_STORE_FLOAT)
+            {
+                value = new SqlDouble(label, (double)numberFloat);
+            }
+            else
+            {
+                value = new SqlDouble(label, numberDouble);
+            }
+            break;
+
+        case SQL_DATE_TYPEID:
+            value = formatMask.empty() ? new SqlDate(label, chars) : new SqlDate(label, chars, formatMask);
+            break;
+
+        case SQL_VARCHAR_TYPEID:
+            value = new SqlVarchar(label, chars);
+            break;
+
+        case SQL_LONG_TYPEID:
+            value = isString ? new SqlLong(label, chars) : new SqlLong(label, number);
+            break;
+
+        default:
+            throw(std::runtime_error("Invalid TypeId in binary record: " + any2string((int)typeId)));
+    }
+
+    for (AttributeContainer::iterator it = attribute.begin(); it != attribute.end(); ++it)
+    {
+        value->setAttribute(it->first, it->second);
+    }
+
+    return value;
+}
+
+static void readColumnValueSet(BinaryReader&   pReader,
+                               ColumnValueSet& pValueSet)
+{
+    unsigned long count = pReader.readUnsigned();
+    pValueSet.reserve(count);
+    for (unsigned long i = 0; i < count; i++)
+    {
+        pValueSet.addValue(readSqlValue(pReader));
+    }
+}
+
+// the operation is registered the same way as the one parsed from XML,
+// returns true when the batch key was taken over by a new batch
+static bool readOperation(BinaryReader&   pReader,
+                          DoLog*          pLog,
+                          ColumnValueSet* pBatchKey)
+{
+    OperationType type = (OperationType)pReader.readByte();
+    if (type != INSERT && type != UPDATE && type != DELETE)
+    {
+        throw(std::runtime_error("Invalid operation type in binary record: " + any2string((int)type)));
+    }
+
+    Symbol entity = pReader.readSymbol();
+    ColumnValueSet key;
+    ColumnValueSet value;
+    readColumnValueSet(pReader, key);
+    readColumnValueSet(pReader, value);
+
+    bool isKeyTaken = false;
+    Operation* operation = pLog->sqlOperation(pBatchKey, type, entity, &isKeyTaken);
+    operation->addKeySet(&key);                 // values taken over
+    if (type == DELETE)
+    {
+        operation->addValueSet(&value, NULL);   // values taken over
+    }
+    else
+    {
+        operation->addValueSet(NULL, &value);   // values taken over
+    }
+
+    return isKeyTaken;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DoLog::binaryParse
+////////////////////////////////////////////////////////////////////////////////
+
+void DoLog::binaryParse(const unsigned char* pBuffer,
+                        const size_t         pBufferLength)
+{
+    TRACE(4, "DoLog::binaryParse");
+
+    BinaryReader reader(pBuffer, pBufferLength);
+    reader.readHead();
+
+    unsigned char tag;
+    while ((tag = reader.readByte()) != BINARY_TAG_END)
+    {
+        if (tag != BINARY_TAG_BATCH)
+        {
+            throw(std::runtime_error("Invalid element in binary record: " + any2string((int)tag)));
+        }
+
+        // the key is taken over by a new batch only, otherwise it is
+        // released here
+        reader.beginBatch();
+        ColumnValueSet* batchKey = new ColumnValueSet;
+        bool isBatchKeyOwned = true;
+        try
+        {
+            readColumnValueSet(reader, *batchKey);
+            while ((tag = reader.readByte()) == BINARY_TAG_OPERATION)
+            {
+                if (readOperation(reader, this, batchKey))
+                {
+                    isBatchKeyOwned = false;
+                }
+            }
+
+            if (tag != BINARY_TAG_BATCH_END)
+            {
+                throw(std::runtime_error("Invalid element in binary batch: " + any2string((int)tag)));
+            }
+        }
+        catch (...)
+        {
+            if (isBatchKeyOwned)
+            {
+                delete batchKey;
+            }
+            throw;
+        }
+
+        batchLoaded(batchKey);
+        if (isBatchKeyOwned)
+        {
+            delete batchKey;
+        }
+    }
+}
+
+}
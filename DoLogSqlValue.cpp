@@ -41,10 +41,15 @@
 #include <map>
 #include <sstream>
 
+#include <string.h>
+#include <stdio.h>
+
 #include "DoLogTerminationHandler.hpp"
 #include "DoLogComponentController.hpp"
 #include "DoLogTrace.hpp"
 #include "DoLogSqlValue.hpp"
+#include "DoLogBinary.hpp"
+#include "DoLogXmlScan.hpp"
 
 using namespace std;
 
@@ -72,72 +77,114 @@ void translate(string& pString,
     }
 }
 
-// decode XML special escape sequence but only for sensible types of values
-string xmlEscCharDecode(SqlValueType pType, string pString)
+// decode XML special escape sequence but only for sensible types of values;
+// the sequences have no terminating ';' and do not overlap so all of them
+// are replaced in one pass, the value without '&' is returned as it is
+string xmlEscCharDecode(SqlValueType pType, const string& pString)
 {
-    string outString = pString;
+    if (pType != SQL_CHAR_TYPEID &&
+        pType != SQL_VARCHAR_TYPEID)
+    {
+        return pString;
+    }
 
-    if (pType == SQL_CHAR_TYPEID ||
-        pType == SQL_VARCHAR_TYPEID)
+    const char* begin = pString.data();
+    const char* end = begin + pString.size();
+    const char* amp = (const char *)memchr(begin, '&', pString.size());
+    if (!amp)
     {
-        translate(outString, "&lt", "<");
-        translate(outString, "&gt", ">");
-        translate(outString, "&quot", "\"");
-        translate(outString, "&apos", "\'");
-        translate(outString, "&amp", "&");
+        return pString;
     }
 
-    return string(outString);
-}
+    static const struct { const char* esc; size_t length; char value; } sequence[] =
+    {
+        { "&lt",   3, '<'  },
+        { "&gt",   3, '>'  },
+        { "&quot", 5, '\"' },
+        { "&apos", 5, '\'' },
+        { "&amp",  4, '&'  }
+    };
 
-// encode XML special characters: <>\'"& but only for sensible types of values
-string xmlEscCharEncode(SqlValueType pType, string pString)
-{
     string outString;
-    stringstream ss;
+    outString.reserve(pString.size());
+    const char* run = begin;
+    while (amp)
+    {
+        outString.append(run, amp - run);
+        size_t i;
+        for (i = 0; i < sizeof(sequence) / sizeof(sequence[0]); i++)
+        {
+            if ((size_t)(end - amp) >= sequence[i].length &&
+                memcmp(amp, sequence[i].esc, sequence[i].length) == 0)
+            {
+                break;
+            }
+        }
+        if (i < sizeof(sequence) / sizeof(sequence[0]))
+        {
+            outString += sequence[i].value;
+            run = amp + sequence[i].length;
+        }
+        else
+        {
+            outString += '&';
+            run = amp + 1;
+        }
+        amp = (const char *)memchr(run, '&', end - run);
+    }
+    outString.append(run, end - run);
 
+    return outString;
+}
+
+// encode XML special characters: <>\'"& but only for sensible types of values,
+// the runs of characters not to be encoded go to the sink in one piece
+void xmlEscCharEncode(SqlValueType pType, const char* pData, size_t pLength, XmlSink& pSink)
+{
+    const char* end = pData + pLength;
+    const char* run = pData;
     if (pType == SQL_CHAR_TYPEID ||
         pType == SQL_VARCHAR_TYPEID)
     {
-        unsigned int i;
-        for (i = 0; i < pString.length(); i++)
+        const char* p;
+        while ((p = xmlScanSpecial(run, end)) < end)
         {
-            switch (pString[i])
+            const char* esc;
+            switch (*p)
             {
-                case '<' : ss << "&lt"; break;
-                case '>' : ss << "&gt"; break;
-                case '\"': ss << "&quot"; break;
-                case '\'': ss << "&apos"; break;
-                case '&' : ss << "&amp"; break;
-                default: ss << pString[i];
+                case '<' : esc = "&lt"; break;
+                case '>' : esc = "&gt"; break;
+                case '\"': esc = "&quot"; break;
+                case '\'': esc = "&apos"; break;
+                default  : esc = "&amp"; break;
             }
+            pSink.write(run, p - run);
+            pSink << esc;
+            run = p + 1;
         }
-
-        outString = ss.str();
-    }
-    else
-    {
-        outString = pString;
     }
-
-    return outString;
+    pSink.write(run, end - run);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-// SqlValue: representation of sql value, ready to show in XML
+// SqlValue: representation of sql value, formatted upon rendering
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlValue::SqlValue(SqlValueType pType, string pLabel, string pValue)
+SqlValue::SqlValue(SqlValueType pType, Symbol pLabel, string pValue)
     : mTypeId(pType),
       mLabel(pLabel),
+      mStorage(SQL_STORE_STRING),
+      mCharsLength(0),
       mValueString(pValue)
 {
     TRACE(4, "SqlValue");
 }
 
-SqlValue::SqlValue(SqlValueType pType, string pLabel)
+SqlValue::SqlValue(SqlValueType pType, Symbol pLabel)
     : mTypeId(pType),
-      mLabel(pLabel)
+      mLabel(pLabel),
+      mStorage(SQL_STORE_STRING),
+      mCharsLength(0)
 {
     TRACE(4, "SqlValue");
 }
@@ -145,12 +192,107 @@ SqlValue::SqlValue(SqlValueType pType, string pLabel)
 SqlValue::~SqlValue()
 {}
 
+void SqlValue::setInt(int pValue)
+{
+    mStorage = SQL_STORE_INT;
+    mInt = pValue;
+}
+
+void SqlValue::setShort(short pValue)
+{
+    mStorage = SQL_STORE_SHORT;
+    mShort = pValue;
+}
+
+void SqlValue::setFloat(float pValue)
+{
+    mStorage = SQL_STORE_FLOAT;
+    mFloat = pValue;
+}
+
+void SqlValue::setDouble(double pValue)
+{
+    mStorage = SQL_STORE_DOUBLE;
+    mDouble = pValue;
+}
+
+void SqlValue::setLong(long pValue)
+{
+    mStorage = SQL_STORE_LONG;
+    mLong = pValue;
+}
+
+// short sequence is copied inline, the long one goes to the string
+void SqlValue::setChars(const char* pValue, size_t pLength)
+{
+    if (pLength <= SQL_VALUE_INLINE_LEN)
+    {
+        mStorage = SQL_STORE_CHARS;
+        mCharsLength = pLength;
+        memcpy(mChars, pValue, pLength);
+    }
+    else
+    {
+        mStorage = SQL_STORE_STRING;
+        mValueString.assign(pValue, pLength);
+    }
+}
+
+// the value in printable form: numbers are formatted into the buffer
+// provided (same format as the stream output), chars are not copied
+const char* SqlValue::formatValue(char* pBuffer, size_t& pLength)
+{
+    int length = 0;
+    switch (mStorage)
+    {
+        case SQL_STORE_INT:
+            length = snprintf(pBuffer, SQL_VALUE_FORMAT_LEN, "%d", mInt);
+            break;
+
+        case SQL_STORE_SHORT:
+            length = snprintf(pBuffer, SQL_VALUE_FORMAT_LEN, "%d", (int)mShort);
+            break;
+
+        case SQL_STORE_FLOAT:
+            length = snprintf(pBuffer, SQL_VALUE_FORMAT_LEN, "%g", (double)mFloat);
+            break;
+
+        case SQL_STORE_DOUBLE:
+            length = snprintf(pBuffer, SQL_VALUE_FORMAT_LEN, "%g", mDouble);
+            break;
+
+        case SQL_STORE_LONG:
+            length = snprintf(pBuffer, SQL_VALUE_FORMAT_LEN, "%ld", mLong);
+            break;
+
+        case SQL_STORE_CHARS:
+            pLength = mCharsLength;
+            return mChars;
+
+        default:
+            pLength = mValueString.length();
+            return mValueString.data();
+    }
+
+    pLength = length;
+    return pBuffer;
+}
+
 string SqlValue::getString()
 {
-    return mValueString;
+    char buffer[SQL_VALUE_FORMAT_LEN];
+    size_t length;
+    const char* value = formatValue(buffer, length);
+    return string(value, length);
 }
 
-string SqlValue::getLabel()
+// the name is resolved from the symbol table
+const string& SqlValue::getLabel()
+{
+    return mLabel.getName();
+}
+
+Symbol SqlValue::getLabelSymbol()
 {
     return mLabel;
 }
@@ -160,59 +302,101 @@ void SqlValue::setAttribute(string pAttribute, string pAttributeValue)
     mAttribute[pAttribute] = pAttributeValue;
 }
 
-string SqlValue::getXmlAttributes()
+void SqlValue::writeXmlAttributes(XmlSink& pSink)
 {
-    stringstream ss;
-    ss << " TypeId=" << "\"" << mTypeId << "\""; // mandatory attribute
+    pSink << " TypeId=" << "\"" << (int)mTypeId << "\""; // mandatory attribute
     // all optional attributes
     map<string, string>::iterator it = mAttribute.begin();
     while (it != mAttribute.end())
     {
-        ss << " ";
-        ss << it->first
-           << "="
-           << "\""
-           << it->second
-           << "\"";
+        pSink << " ";
+        pSink << it->first
+              << "="
+              << "\""
+              << it->second
+              << "\"";
         ++it;
     }
-    return ss.str();
 }
 
-string SqlValue::getXml()
+void SqlValue::writeXml(XmlSink& pSink)
 {
-    stringstream ss;
-    ss << "<"
-       << mLabel
-       << getXmlAttributes()
-       << ">"
-       << xmlEscCharEncode(mTypeId, mValueString)
-       << "</"
-       << mLabel
-       << ">";
-    return ss.str();
+    char buffer[SQL_VALUE_FORMAT_LEN];
+    size_t length;
+    const char* value = formatValue(buffer, length);
+
+    const string& label = mLabel.getName();
+    pSink << "<" << label;
+    writeXmlAttributes(pSink);
+    pSink << ">";
+    xmlEscCharEncode(mTypeId, value, length, pSink);
+    pSink << "</" << label << ">";
+}
+
+// the value is written in its native form, no formatting needed
+void SqlValue::writeBinary(BinaryWriter& pWriter)
+{
+    pWriter.writeByte((unsigned char)mTypeId);
+    pWriter.writeByte((unsigned char)mStorage);
+    pWriter.writeSymbol(mLabel);
+    pWriter.writeUnsigned(mAttribute.size());
+    for (map<string, string>::iterator it = mAttribute.begin(); it != mAttribute.end(); ++it)
+    {
+        pWriter.writeString(it->first);
+        pWriter.writeString(it->second);
+    }
+
+    switch (mStorage)
+    {
+        case SQL_STORE_INT:
+            pWriter.writeSigned(mInt);
+            break;
+
+        case SQL_STORE_SHORT:
+            pWriter.writeSigned(mShort);
+            break;
+
+        case SQL_STORE_LONG:
+            pWriter.writeSigned(mLong);
+            break;
+
+        case SQL_STORE_FLOAT:
+            pWriter.writeFloat(mFloat);
+            break;
+
+        case SQL_STORE_DOUBLE:
+            pWriter.writeDouble(mDouble);
+            break;
+
+        case SQL_STORE_CHARS:
+            pWriter.writeString(mChars, mCharsLength);
+            break;
+
+        default:
+            pWriter.writeString(mValueString);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlChar
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlChar::SqlChar(string pLabel, string pValueString)
+SqlChar::SqlChar(Symbol pLabel, string pValueString)
     : SqlValue(SQL_CHAR_TYPEID, pLabel, pValueString)
 {}
 
-SqlChar::SqlChar(string pLabel, char* pValueChar)
-    : SqlValue(SQL_CHAR_TYPEID, pLabel, string(pValueChar))
-{}
+SqlChar::SqlChar(Symbol pLabel, char* pValueChar)
+    : SqlValue(SQL_CHAR_TYPEID, pLabel)
+{
+    setChars(pValueChar, strlen(pValueChar));
+}
 
-SqlChar::SqlChar(string pLabel, void* pValueAny)
+SqlChar::SqlChar(Symbol pLabel, void* pValueAny)
     : SqlValue(SQL_CHAR_TYPEID, pLabel)
 {
     TRACE(4, "SqlChar");
     char* tmpValue = static_cast<char *>(pValueAny);
-    string tmpString(tmpValue);
-    TRACE_MSG("SqlChar: " + tmpString);
-    mValueString = tmpString;
+    setChars(tmpValue, strlen(tmpValue));
 }
 
 SqlChar* SqlChar::clone()
@@ -222,29 +406,28 @@ SqlChar* SqlChar::clone()
 
 string SqlChar::getValue()
 {
-    return "\'" + mValueString + "\'";
+    return "\'" + getString() + "\'";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlInteger
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlInteger::SqlInteger(string pLabel, string pValueString)
+SqlInteger::SqlInteger(Symbol pLabel, string pValueString)
     : SqlValue(SQL_INTEGER_TYPEID, pLabel, pValueString)
 {}
 
-SqlInteger::SqlInteger(string pLabel, int pValueInt)
-    : SqlValue(SQL_INTEGER_TYPEID, pLabel, any2string(pValueInt))
-{}
+SqlInteger::SqlInteger(Symbol pLabel, int pValueInt)
+    : SqlValue(SQL_INTEGER_TYPEID, pLabel)
+{
+    setInt(pValueInt);
+}
 
-SqlInteger::SqlInteger(string pLabel, void *pValueAny)
+SqlInteger::SqlInteger(Symbol pLabel, void *pValueAny)
     : SqlValue(SQL_INTEGER_TYPEID, pLabel)
 {
     TRACE(4, "SqlInteger");
-    int *tmpValue = static_cast<int *>(pValueAny);
-    string tmpString = any2string(*tmpValue);
-    TRACE_MSG("SqlInteger: " + tmpString);
-    mValueString = tmpString;
+    setInt(*static_cast<int *>(pValueAny));
 }
 
 SqlInteger* SqlInteger::clone()
@@ -254,29 +437,28 @@ SqlInteger* SqlInteger::clone()
 
 string SqlInteger::getValue()
 {
-    return mValueString;
+    return getString();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlSmallint
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlSmallint::SqlSmallint(string pLabel, string pValueString)
+SqlSmallint::SqlSmallint(Symbol pLabel, string pValueString)
     : SqlValue(SQL_SMALLINT_TYPEID, pLabel, pValueString)
 {}
 
-SqlSmallint::SqlSmallint(string pLabel, short pValueShort)
-    : SqlValue(SQL_SMALLINT_TYPEID, pLabel, any2string(pValueShort))
-{}
+SqlSmallint::SqlSmallint(Symbol pLabel, short pValueShort)
+    : SqlValue(SQL_SMALLINT_TYPEID, pLabel)
+{
+    setShort(pValueShort);
+}
 
-SqlSmallint::SqlSmallint(string pLabel, void *pValueAny)
+SqlSmallint::SqlSmallint(Symbol pLabel, void *pValueAny)
     : SqlValue(SQL_SMALLINT_TYPEID, pLabel)
 {
     TRACE(4, "SqlSmallint");
-    short *tmpValue = static_cast<short *>(pValueAny);
-    string tmpString = any2string(*tmpValue);
-    TRACE_MSG("SqlSmallint: " + tmpString);
-    mValueString = tmpString;
+    setShort(*static_cast<short *>(pValueAny));
 }
 
 SqlSmallint* SqlSmallint::clone()
@@ -286,29 +468,28 @@ SqlSmallint* SqlSmallint::clone()
 
 string SqlSmallint::getValue()
 {
-    return mValueString;
+    return getString();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlFloat
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlFloat::SqlFloat(string pLabel, string pValueString)
+SqlFloat::SqlFloat(Symbol pLabel, string pValueString)
     : SqlValue(SQL_FLOAT_TYPEID, pLabel, pValueString)
 {}
 
-SqlFloat::SqlFloat(string pLabel, float pValueFloat)
-    : SqlValue(SQL_FLOAT_TYPEID, pLabel, any2string(pValueFloat))
-{}
+SqlFloat::SqlFloat(Symbol pLabel, float pValueFloat)
+    : SqlValue(SQL_FLOAT_TYPEID, pLabel)
+{
+    setFloat(pValueFloat);
+}
 
-SqlFloat::SqlFloat(string pLabel, void *pValueAny)
+SqlFloat::SqlFloat(Symbol pLabel, void *pValueAny)
     : SqlValue(SQL_FLOAT_TYPEID, pLabel)
 {
     TRACE(4, "SqlFloat");
-    float *tmpValue = static_cast<float *>(pValueAny);
-    string tmpString = any2string(*tmpValue);
-    TRACE_MSG("SqlFloat: " + tmpString);
-    mValueString = tmpString;
+    setFloat(*static_cast<float *>(pValueAny));
 }
 
 SqlFloat* SqlFloat::clone()
@@ -318,29 +499,28 @@ SqlFloat* SqlFloat::clone()
 
 string SqlFloat::getValue()
 {
-    return mValueString;
+    return getString();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlDouble
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlDouble::SqlDouble(string pLabel, string pValueString)
+SqlDouble::SqlDouble(Symbol pLabel, string pValueString)
     : SqlValue(SQL_DOUBLE_TYPEID, pLabel, pValueString)
 {}
 
-SqlDouble::SqlDouble(string pLabel, double pValueDouble)
-    : SqlValue(SQL_DOUBLE_TYPEID, pLabel, any2string(pValueDouble))
-{}
+SqlDouble::SqlDouble(Symbol pLabel, double pValueDouble)
+    : SqlValue(SQL_DOUBLE_TYPEID, pLabel)
+{
+    setDouble(pValueDouble);
+}
 
-SqlDouble::SqlDouble(string pLabel, void *pValueAny)
+SqlDouble::SqlDouble(Symbol pLabel, void *pValueAny)
     : SqlValue(SQL_FLOAT_TYPEID, pLabel)
 {
     TRACE(4, "SqlDouble");
-    double *tmpValue = static_cast<double *>(pValueAny);
-    string tmpString = any2string(*tmpValue);
-    TRACE_MSG("SqlDouble: " + tmpString);
-    mValueString = tmpString;
+    setDouble(*static_cast<double *>(pValueAny));
 }
 
 SqlDouble* SqlDouble::clone()
@@ -350,36 +530,34 @@ SqlDouble* SqlDouble::clone()
 
 string SqlDouble::getValue()
 {
-    return mValueString;
+    return getString();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlDate
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlDate::SqlDate(string pLabel, string pValueString)
+SqlDate::SqlDate(Symbol pLabel, string pValueString)
     : SqlValue(SQL_DATE_TYPEID, pLabel, pValueString),
       mFormatMask(string("YYYYMMDDHH24MISS"))
 {
     SqlValue::setAttribute("FormatMask", mFormatMask);
 }
 
-SqlDate::SqlDate(string pLabel, string pValueString, string pFormatMask)
+SqlDate::SqlDate(Symbol pLabel, string pValueString, string pFormatMask)
     : SqlValue(SQL_DATE_TYPEID, pLabel, pValueString),
       mFormatMask(pFormatMask)
 {
     SqlValue::setAttribute("FormatMask", mFormatMask);
 }
 
-SqlDate::SqlDate(string pLabel, void *pValueAny)
+SqlDate::SqlDate(Symbol pLabel, void *pValueAny)
     : SqlValue(SQL_DATE_TYPEID, pLabel),
       mFormatMask(string("YYYYMMDDHH24MISS"))
 {
     TRACE(4, "SqlDate");
     char *tmpValue = static_cast<char *>(pValueAny);
-    string tmpString(tmpValue);
-    TRACE_MSG("Integer: " + tmpString);
-    mValueString = tmpString;
+    setChars(tmpValue, strlen(tmpValue));
 }
 
 SqlDate* SqlDate::clone()
@@ -395,7 +573,7 @@ string SqlDate::getValue()
     {
         format = ",\'" + mFormatMask + "\'";
     }
-    ss << "TO_DATE(" << "\'" << mValueString << "\'" << format << ")";
+    ss << "TO_DATE(" << "\'" << getString() << "\'" << format << ")";
     return ss.str();
 }
 
@@ -403,18 +581,16 @@ string SqlDate::getValue()
 // SqlVarchar
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlVarchar::SqlVarchar(string pLabel, string pValueString)
+SqlVarchar::SqlVarchar(Symbol pLabel, string pValueString)
     : SqlValue(SQL_VARCHAR_TYPEID, pLabel, pValueString)
 {}
 
-SqlVarchar::SqlVarchar(string pLabel, void* pValueAny)
+SqlVarchar::SqlVarchar(Symbol pLabel, void* pValueAny)
     : SqlValue(SQL_VARCHAR_TYPEID, pLabel)
 {
     TRACE(4, __func__);
     Varchar *tmpValue = static_cast<Varchar*>(pValueAny);
-    string tmpString((char *)tmpValue->arr, tmpValue->len);
-    TRACE_MSG("Varchar: " + tmpString);
-    mValueString = tmpString;
+    setChars((char *)tmpValue->arr, tmpValue->len);
 }
 
 SqlVarchar* SqlVarchar::clone()
@@ -424,29 +600,34 @@ SqlVarchar* SqlVarchar::clone()
 
 string SqlVarchar::getValue()
 {
-    return "\'" + mValueString + "\'";
+    return "\'" + getString() + "\'";
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // SqlLong
 ////////////////////////////////////////////////////////////////////////////////
 
-SqlLong::SqlLong(string pLabel, string pValueString)
+SqlLong::SqlLong(Symbol pLabel, string pValueString)
     : SqlValue(SQL_LONG_TYPEID, pLabel, pValueString)
 {}
 
-SqlLong::SqlLong(string pLabel, int pValueLong)
-    : SqlValue(SQL_LONG_TYPEID, pLabel, any2string(pValueLong))
-{}
+SqlLong::SqlLong(Symbol pLabel, int pValueLong)
+    : SqlValue(SQL_LONG_TYPEID, pLabel)
+{
+    setLong(pValueLong);
+}
+
+SqlLong::SqlLong(Symbol pLabel, long pValueLong)
+    : SqlValue(SQL_LONG_TYPEID, pLabel)
+{
+    setLong(pValueLong);
+}
 
-SqlLong::SqlLong(string pLabel, void *pValueAny)
+SqlLong::SqlLong(Symbol pLabel, void *pValueAny)
     : SqlValue(SQL_LONG_TYPEID, pLabel)
 {
     TRACE(4, "SqlLong");
-    long *tmpValue = static_cast<long *>(pValueAny);
-    string tmpString = any2string(*tmpValue);
-    TRACE_MSG("SqlLong: " + tmpString);
-    mValueString = tmpString;
+    setLong(*static_cast<long *>(pValueAny));
 }
 
 SqlLong* SqlLong::clone()
@@ -456,7 +637,7 @@ SqlLong* SqlLong::clone()
 
 string SqlLong::getValue()
 {
-    return mValueString;
+    return getString();
 }
 
 }
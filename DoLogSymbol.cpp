@@ -0,0 +1,327 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogSymbol.cpp
+// Description: Implementation of process wide table of interned names.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-12
+// Abstract   : Implementation of table of interned names.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#include <string>
+#include <vector>
+#include <deque>
+
+#include <string.h>
+#include <pthread.h>
+
+#include "DoLogSymbol.hpp"
+
+namespace dolog
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// SymbolTable: open addressing hash table of names, the names are kept
+// in a deque so the references to them stay valid, shared by all threads.
+// The known names are looked up without lock, only a new name is added
+// under lock. A slot is published by the release store of its id, a grown
+// table by the release store of its pointer, the replaced tables are kept
+// until the end since a reader may still probe them.
+////////////////////////////////////////////////////////////////////////////////
+
+struct SymbolSlot
+{
+    unsigned int       hash;
+    SymbolId           id;    // index of name + 1, 0 - empty slot
+    const std::string* name;
+};
+
+struct SymbolSlotTable
+{
+    SymbolSlotTable(size_t pSize);
+    std::vector<SymbolSlot>    mSlot;
+    size_t                     mMask;
+};
+
+SymbolSlotTable::SymbolSlotTable(size_t pSize)
+{
+    SymbolSlot empty = { 0, 0, NULL };
+    mSlot.resize(pSize, empty);
+    mMask = pSize - 1;
+}
+
+class SymbolTable
+{
+public:
+    SymbolTable();
+    ~SymbolTable();
+    const std::string*         intern(const char* pName,
+                                      size_t      pLength,
+                                      SymbolId&   pId);
+    const std::string*         find(const char* pName,
+                                    size_t      pLength,
+                                    SymbolId&   pId);
+    size_t                     count();
+private:
+    bool                       probe(SymbolSlotTable* pTable,
+                                     unsigned int     pHash,
+                                     const char*      pName,
+                                     size_t           pLength,
+                                     SymbolSlot*&     pSlot);
+    void                       grow();
+    SymbolSlotTable*           mTable;
+    std::vector<SymbolSlotTable*> mRetired;
+    std::deque<std::string>    mName;
+    const std::string*         mEmpty;
+    pthread_mutex_t            mMutex;
+};
+
+// lock held until the end of the scope
+class SymbolTableLock
+{
+public:
+    SymbolTableLock(pthread_mutex_t& pMutex) : mMutex(pMutex) { pthread_mutex_lock(&mMutex); }
+    ~SymbolTableLock() { pthread_mutex_unlock(&mMutex); }
+private:
+    pthread_mutex_t& mMutex;
+};
+
+// FNV-1a
+static unsigned int symbolHash(const char* pName,
+                               size_t      pLength)
+{
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < pLength; i++)
+    {
+        hash ^= (unsigned char)pName[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// the empty name has always id 0
+SymbolTable::SymbolTable()
+{
+    mTable = new SymbolSlotTable(SYMBOL_TABLE_INIT_SIZE);
+    mName.push_back("");
+    mEmpty = &mName[0];
+    pthread_mutex_init(&mMutex, NULL);
+}
+
+SymbolTable::~SymbolTable()
+{
+    for (size_t i = 0; i < mRetired.size(); i++)
+    {
+        delete mRetired[i];
+    }
+    delete mTable;
+    pthread_mutex_destroy(&mMutex);
+}
+
+// true and the slot of the name if found, otherwise false and the empty
+// slot ending its chain; a slot is read only after its id is seen, so any
+// thread may probe
+bool SymbolTable::probe(SymbolSlotTable* pTable,
+                        unsigned int     pHash,
+                        const char*      pName,
+                        size_t           pLength,
+                        SymbolSlot*&     pSlot)
+{
+    size_t i = pHash & pTable->mMask;
+    SymbolSlot* slot = &pTable->mSlot[i];
+    while (__atomic_load_n(&slot->id, __ATOMIC_ACQUIRE))
+    {
+        if (slot->hash == pHash &&
+            slot->name->size() == pLength &&
+            memcmp(slot->name->data(), pName, pLength) == 0)
+        {
+            pSlot = slot;
+            return true;
+        }
+        i = (i + 1) & pTable->mMask;
+        slot = &pTable->mSlot[i];
+    }
+
+    pSlot = slot;
+    return false;
+}
+
+// lookup is done without building a string and without lock, only a new
+// name is copied under lock
+const std::string* SymbolTable::intern(const char* pName,
+                                       size_t      pLength,
+                                       SymbolId&   pId)
+{
+    if (pLength == 0)
+    {
+        pId = 0;
+        return mEmpty;
+    }
+
+    unsigned int hash = symbolHash(pName, pLength);
+    SymbolSlot* slot;
+    if (probe(__atomic_load_n(&mTable, __ATOMIC_ACQUIRE), hash, pName, pLength, slot))
+    {
+        pId = slot->id;
+        return slot->name;
+    }
+
+    // the name may be added meanwhile by another thread, so probed again
+    SymbolTableLock lock(mMutex);
+    if (probe(mTable, hash, pName, pLength, slot))
+    {
+        pId = slot->id;
+        return slot->name;
+    }
+
+    SymbolId id = mName.size();
+    mName.push_back(std::string(pName, pLength));
+    const std::string* name = &mName.back();
+    slot->hash = hash;
+    slot->name = name;
+    __atomic_store_n(&slot->id, id, __ATOMIC_RELEASE);
+
+    // load factor kept below 1/2
+    if (2 * mName.size() > mTable->mSlot.size())
+    {
+        grow();
+    }
+
+    pId = id;
+    return name;
+}
+
+// lookup only, an unknown name is not added, NULL is returned for it
+const std::string* SymbolTable::find(const char* pName,
+                                     size_t      pLength,
+                                     SymbolId&   pId)
+{
+    if (pLength == 0)
+    {
+        pId = 0;
+        return mEmpty;
+    }
+
+    unsigned int hash = symbolHash(pName, pLength);
+    SymbolSlot* slot;
+    if (!probe(__atomic_load_n(&mTable, __ATOMIC_ACQUIRE), hash, pName, pLength, slot))
+    {
+        // the name may be added meanwhile by another thread, so probed again
+        SymbolTableLock lock(mMutex);
+        if (!probe(mTable, hash, pName, pLength, slot))
+        {
+            return NULL;
+        }
+    }
+
+    pId = slot->id;
+    return slot->name;
+}
+
+size_t SymbolTable::count()
+{
+    SymbolTableLock lock(mMutex);
+    return mName.size();
+}
+
+// rehash of all the names into the table of double size, called under lock
+void SymbolTable::grow()
+{
+    SymbolSlotTable* table = new SymbolSlotTable(2 * mTable->mSlot.size());
+
+    for (size_t j = 0; j < mTable->mSlot.size(); j++)
+    {
+        const SymbolSlot& slot = mTable->mSlot[j];
+        if (slot.id)
+        {
+            size_t i = slot.hash & table->mMask;
+            while (table->mSlot[i].id)
+            {
+                i = (i + 1) & table->mMask;
+            }
+            table->mSlot[i] = slot;
+        }
+    }
+
+    mRetired.push_back(mTable);
+    __atomic_store_n(&mTable, table, __ATOMIC_RELEASE);
+}
+
+// the table is created upon first use, the initialization is guarded by compiler
+static SymbolTable& symbolTable()
+{
+    static SymbolTable sTable;
+    return sTable;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Symbol
+////////////////////////////////////////////////////////////////////////////////
+
+Symbol::Symbol()
+{
+    mName = symbolTable().intern("", 0, mId);
+}
+
+Symbol::Symbol(const char* pName)
+{
+    mName = symbolTable().intern(pName ? pName : "", pName ? strlen(pName) : 0, mId);
+}
+
+Symbol::Symbol(const char* pName,
+               size_t      pLength)
+{
+    mName = symbolTable().intern(pName, pLength, mId);
+}
+
+Symbol::Symbol(const std::string& pName)
+{
+    mName = symbolTable().intern(pName.data(), pName.size(), mId);
+}
+
+// the symbol is set only if the name was already interned
+bool Symbol::find(const std::string& pName,
+                  Symbol&            pSymbol)
+{
+    SymbolId id;
+    const std::string* name = symbolTable().find(pName.data(), pName.size(), id);
+    if (name == NULL)
+    {
+        return false;
+    }
+
+    pSymbol.mId = id;
+    pSymbol.mName = name;
+    return true;
+}
+
+size_t Symbol::getCount()
+{
+    return symbolTable().count();
+}
+
+}
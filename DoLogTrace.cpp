@@ -35,6 +35,8 @@
  * static char *SCCS_VERSION = "%I%";
  */
 
+#include <stdio.h>
+
 #include "DoLogComponentController.hpp"
 #include "DoLogTerminationHandler.hpp"
 #include "DoLogTrace.hpp"
@@ -42,38 +44,38 @@
 namespace dolog
 {
 
-int Trace::sCallLevel = 0;
+__thread int Trace::sCallLevel = 0;
+
+volatile int Trace::sLevel = -1;
 
-// trace message format: [CALL_LEVEL_N]<N Spaces><FunctionName> message
+// trace message format: [CALL_LEVEL_N]<N Spaces><FunctionName> message,
+// the call level counts only the functions traced
 std::string Trace::prefix()
 {
-    std::stringstream ss;
+    char level[16];
+    snprintf(level, sizeof(level), "[%d] ", sCallLevel);
 
-    ss << "DOLOG ";
-    ss << "[" << Trace::sCallLevel << "] ";
-    for (int i = 0; i < sCallLevel; i++)
-    {
-        ss << " ";
-    }
-    ss << Trace::mCurrentFunctionName;
+    std::string s("DOLOG ");
+    s += level;
+    s.append(sCallLevel, ' ');
+    s += mCurrentFunctionName;
 
-    return ss.str();
+    return s;
 }
 
-// store the level and name, all calls to Trace methods will use it
-Trace::Trace(const int pLevel, const char *pFunctionName)
-    : mCurrentFunctionName(pFunctionName), mCurrentFunctionTraceLevel(pLevel)
+// entry of the traced function
+void Trace::enter()
 {
     ++sCallLevel;
 
-    DOLOG_TRACE_STREAM(pLevel)
+    DOLOG_TRACE_STREAM(mCurrentFunctionTraceLevel)
         << this->prefix()
         << " - Started"
         << std::endl;
 }
 
-// print info upon destruction while exiting from current context (also function)
-Trace::~Trace()
+// exit from the traced function
+void Trace::leave()
 {
     DOLOG_TRACE_STREAM(mCurrentFunctionTraceLevel)
         << this->prefix()
@@ -83,10 +85,18 @@ Trace::~Trace()
     --sCallLevel;
 }
 
+// the level configured in the controller is used until it is set
+int Trace::loadLevel()
+{
+    sLevel = DOLOG_TRACE_LEVEL;
+    return sLevel;
+}
+
 // used upon startup to determine the treshold for logging
 void Trace::setLevel(int pTraceLevel)
 {
     DOLOG_TRACE_LEVEL_SET(pTraceLevel);
+    sLevel = pTraceLevel;
 }
 
 // print general info about step of execution in a LOG stream
@@ -119,6 +129,11 @@ void Trace::trace(const std::string& pMessage)
 void Trace::trace(const int pLevel,
                   const std::string& pMessage)
 {
+    if (!isEnabled(pLevel))
+    {
+        return;
+    }
+
     DOLOG_TRACE_STREAM(pLevel)
         << prefix()
         << ": "
@@ -0,0 +1,589 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogXmlDedicatedParse.cpp
+// Description: Implementation of dedicated XML parsing method of class DoLog.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-30
+// Abstract   : Parser of the UNDOLOG documents written by the library. It reads
+//              the bytes in place and builds the values from byte ranges
+//              without transcoding.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#include <string>
+#include <stdexcept>
+
+#include <string.h>
+
+#include "DoLogTerminationHandler.hpp"
+#include "DoLogComponentController.hpp"
+#include "DoLogTrace.hpp"
+#include "DoLogSqlValue.hpp"
+#include "DoLog.hpp"
+#include "DoLogXmlParse.hpp"
+#include "DoLogXmlScan.hpp"
+
+using namespace std;
+
+namespace dolog
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// scanning of the bytes
+////////////////////////////////////////////////////////////////////////////////
+
+static inline bool isSpace(char pChar)
+{
+    return pChar == ' ' || pChar == '\n' || pChar == '\t' || pChar == '\r';
+}
+
+static inline bool isNameEnd(char pChar)
+{
+    return isSpace(pChar) || pChar == '>' || pChar == '/' || pChar == '=';
+}
+
+// the document uses only the markup written by the library: no declaration,
+// comment, CDATA, processing instruction or character reference and no
+// carriage return to be normalized; otherwise it is left to Xerces
+static bool isDedicatedSubset(const char* pBegin,
+                              const char* pEnd)
+{
+    const char* p = pBegin;
+    while ((p = xmlScanFor(p, pEnd, '<', '&', '\r')) < pEnd)
+    {
+        if (*p == '\r' || p + 1 == pEnd)
+        {
+            return false;
+        }
+        if (*p == '<' && (p[1] == '!' || p[1] == '?'))
+        {
+            return false;
+        }
+        if (*p == '&' && p[1] == '#')
+        {
+            return false;
+        }
+        p++;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// XmlDedicatedParser: recursive descent over the elements of fixed levels
+// UNDOLOG > BATCH > DIGEST KEY INSERT UPDATE DELETE > ENTITY KEY VALUE > columns.
+// The errors are reported with the same messages as by the Xerces loader.
+////////////////////////////////////////////////////////////////////////////////
+
+struct XmlTag
+{
+    const char* name;
+    size_t      nameLength;
+    bool        isEnd;        // </name>
+    bool        isEmpty;      // <name/>
+    const char* typeId;       // value of TypeId attribute, NULL - none
+    size_t      typeIdLength;
+};
+
+class XmlDedicatedParser
+{
+public:
+    XmlDedicatedParser(DoLog*      pLog,
+                       const char* pBegin,
+                       const char* pEnd);
+    ~XmlDedicatedParser();
+    void            parse();
+private:
+    XmlDedicatedParser(const XmlDedicatedParser&);
+    void            nextTag(XmlTag& pTag);
+    void            endTag(const XmlTag& pStartTag);
+    void            checkEndTag(const XmlTag& pTag,
+                                const XmlTag& pStartTag);
+    void            text(string& pText);
+    void            skipElement(const XmlTag& pStartTag);
+    void            parseBatch(const XmlTag& pStartTag);
+    void            parseOperation(const XmlTag& pStartTag,
+                                   OperationType pType);
+    void            parseValueSet(const XmlTag&   pStartTag,
+                                  ColumnValueSet& pValueSet);
+    DoLog*          mLog;
+    const char*     mPos;
+    const char*     mEnd;
+    ColumnValueSet* mBatchKey;
+    bool            mIsBatchKeyOwned;   // not taken over by any batch yet
+    ColumnValueSet* mOperationKey;
+    ColumnValueSet* mOperationValue;
+    string          mText;              // reused for all values
+};
+
+static inline bool tagNameEq(const XmlTag& pTag,
+                             const char*   pName)
+{
+    size_t length = strlen(pName);
+    return pTag.nameLength == length && memcmp(pTag.name, pName, length) == 0;
+}
+
+static inline string tagName(const XmlTag& pTag)
+{
+    return string(pTag.name, pTag.nameLength);
+}
+
+XmlDedicatedParser::XmlDedicatedParser(DoLog*      pLog,
+                                       const char* pBegin,
+                                       const char* pEnd) : mLog(pLog),
+                                                           mPos(pBegin),
+                                                           mEnd(pEnd),
+                                                           mBatchKey(NULL),
+                                                           mIsBatchKeyOwned(false),
+                                                           mOperationKey(NULL),
+                                                           mOperationValue(NULL)
+{
+}
+
+// the values of the batch or operation not completed due to an error
+XmlDedicatedParser::~XmlDedicatedParser()
+{
+    if (mIsBatchKeyOwned)
+    {
+        delete mBatchKey;
+    }
+    delete mOperationKey;
+    delete mOperationValue;
+}
+
+// the text between elements is skipped, the tag is read with its TypeId
+void XmlDedicatedParser::nextTag(XmlTag& pTag)
+{
+    mPos = xmlScanFor(mPos, mEnd, '<', '<', '<');
+    if (mPos == mEnd)
+    {
+        throw(std::runtime_error( "Unexpected end of XML document" ));
+    }
+    mPos++;
+
+    pTag.isEnd = (mPos < mEnd && *mPos == '/');
+    if (pTag.isEnd)
+    {
+        mPos++;
+    }
+    pTag.isEmpty = false;
+    pTag.typeId = NULL;
+    pTag.typeIdLength = 0;
+
+    pTag.name = mPos;
+    while (mPos < mEnd && !isNameEnd(*mPos))
+    {
+        mPos++;
+    }
+    pTag.nameLength = mPos - pTag.name;
+    if (pTag.nameLength == 0)
+    {
+        throw(std::runtime_error( "Empty XML element name" ));
+    }
+
+    // attributes: name="value" or name='value'
+    while (true)
+    {
+        while (mPos < mEnd && isSpace(*mPos))
+        {
+            mPos++;
+        }
+        if (mPos == mEnd)
+        {
+            throw(std::runtime_error( "Unexpected end of XML document" ));
+        }
+        if (*mPos == '>')
+        {
+            mPos++;
+            return;
+        }
+        if (*mPos == '/' && !pTag.isEnd && mPos + 1 < mEnd && mPos[1] == '>')
+        {
+            pTag.isEmpty = true;
+            mPos += 2;
+            return;
+        }
+        if (pTag.isEnd)
+        {
+            throw(std::runtime_error( "Invalid end tag: " + tagName(pTag)));
+        }
+
+        const char* attribute = mPos;
+        while (mPos < mEnd && !isNameEnd(*mPos))
+        {
+            mPos++;
+        }
+        size_t attributeLength = mPos - attribute;
+        while (mPos < mEnd && isSpace(*mPos))
+        {
+            mPos++;
+        }
+        if (attributeLength == 0 || mPos + 1 >= mEnd || *mPos != '=')
+        {
+            throw(std::runtime_error( "Invalid attribute of element: " + tagName(pTag)));
+        }
+        mPos++;
+        while (mPos < mEnd && isSpace(*mPos))
+        {
+            mPos++;
+        }
+        if (mPos == mEnd || (*mPos != '"' && *mPos != '\''))
+        {
+            throw(std::runtime_error( "Invalid attribute of element: " + tagName(pTag)));
+        }
+
+        char quote = *mPos++;
+        const char* value = mPos;
+        mPos = xmlScanFor(mPos, mEnd, quote, quote, quote);
+        if (mPos == mEnd)
+        {
+            throw(std::runtime_error( "Unexpected end of XML document" ));
+        }
+        if (attributeLength == 6 && memcmp(attribute, "TypeId", 6) == 0)
+        {
+            pTag.typeId = value;
+            pTag.typeIdLength = mPos - value;
+        }
+        mPos++;
+    }
+}
+
+// the next tag must close the given one
+void XmlDedicatedParser::endTag(const XmlTag& pStartTag)
+{
+    XmlTag tag;
+    nextTag(tag);
+    checkEndTag(tag, pStartTag);
+}
+
+void XmlDedicatedParser::checkEndTag(const XmlTag& pTag,
+                                     const XmlTag& pStartTag)
+{
+    if (!pTag.isEnd ||
+        pTag.nameLength != pStartTag.nameLength ||
+        memcmp(pTag.name, pStartTag.name, pTag.nameLength) != 0)
+    {
+        throw(std::runtime_error( "XML element not closed: " + tagName(pStartTag)));
+    }
+}
+
+// text up to the next tag with the predefined entities replaced, the other
+// references are kept as they are for the decoding of SQL values
+void XmlDedicatedParser::text(string& pText)
+{
+    pText.clear();
+    while (true)
+    {
+        const char* run = mPos;
+        mPos = xmlScanFor(mPos, mEnd, '<', '&', '<');
+        pText.append(run, mPos - run);
+        if (mPos == mEnd || *mPos == '<')
+        {
+            return;
+        }
+
+        // &name;
+        static const struct { const char* name; size_t length; char value; } entity[] =
+        {
+            { "&lt;",   4, '<'  },
+            { "&gt;",   4, '>'  },
+            { "&amp;",  5, '&'  },
+            { "&quot;", 6, '"'  },
+            { "&apos;", 6, '\'' }
+        };
+        size_t i;
+        for (i = 0; i < sizeof(entity) / sizeof(entity[0]); i++)
+        {
+            if ((size_t)(mEnd - mPos) >= entity[i].length &&
+                memcmp(mPos, entity[i].name, entity[i].length) == 0)
+            {
+                pText += entity[i].value;
+                mPos += entity[i].length;
+                break;
+            }
+        }
+        if (i == sizeof(entity) / sizeof(entity[0]))
+        {
+            pText += *mPos++;
+        }
+    }
+}
+
+// content of the element is not needed
+void XmlDedicatedParser::skipElement(const XmlTag& pStartTag)
+{
+    int depth = 1;
+    XmlTag tag;
+    while (!pStartTag.isEmpty && depth > 0)
+    {
+        nextTag(tag);
+        if (tag.isEnd)
+        {
+            depth--;
+        }
+        else if (!tag.isEmpty)
+        {
+            depth++;
+        }
+    }
+}
+
+void XmlDedicatedParser::parse()
+{
+    TRACE(4, "XmlDedicatedParser::parse");
+
+    // UNDOLOG
+    XmlTag tag;
+    nextTag(tag);
+    if (tag.isEnd || !tagNameEq(tag, "UNDOLOG"))
+    {
+        throw(std::runtime_error( "XML document level 1 root element not UNDOLOG" ));
+    }
+
+    // for each sub-node: BATCH
+    XmlTag undologTag = tag;
+    while (!undologTag.isEmpty)
+    {
+        nextTag(tag);
+        if (tag.isEnd)
+        {
+            checkEndTag(tag, undologTag);
+            break;
+        }
+        if (!tagNameEq(tag, "BATCH"))
+        {
+            throw(std::runtime_error( "XML document level 2 element not BATCH" ));
+        }
+        parseBatch(tag);
+    }
+}
+
+// DIGEST KEY INSERT UPDATE DELETE
+void XmlDedicatedParser::parseBatch(const XmlTag& pStartTag)
+{
+    TRACE(4, "XmlDedicatedParser::parseBatch");
+
+    XmlTag tag;
+    while (!pStartTag.isEmpty)
+    {
+        nextTag(tag);
+        if (tag.isEnd)
+        {
+            checkEndTag(tag, pStartTag);
+            break;
+        }
+
+        if (tagNameEq(tag, "DIGEST"))
+        {
+            // NOP - digest not needed
+            skipElement(tag);
+        }
+        else if (tagNameEq(tag, "KEY"))
+        {
+            if (mBatchKey)
+            {
+                throw(std::runtime_error( "BATCH KEY repeated" ));
+            }
+            mBatchKey = new ColumnValueSet;
+            mIsBatchKeyOwned = true;
+            parseValueSet(tag, *mBatchKey);
+        }
+        else if (tagNameEq(tag, "INSERT"))
+        {
+            parseOperation(tag, INSERT);
+        }
+        else if (tagNameEq(tag, "UPDATE"))
+        {
+            parseOperation(tag, UPDATE);
+        }
+        else if (tagNameEq(tag, "DELETE"))
+        {
+            parseOperation(tag, DELETE);
+        }
+        else
+        {
+            throw(std::runtime_error( "Invalid element found: " + tagName(tag)));
+        }
+    }
+
+    // the key was taken over by the batch unless no operation used it
+    mLog->batchLoaded(mBatchKey);
+    if (mIsBatchKeyOwned)
+    {
+        delete mBatchKey;
+    }
+    mBatchKey = NULL;
+    mIsBatchKeyOwned = false;
+}
+
+// ENTITY KEY VALUE
+void XmlDedicatedParser::parseOperation(const XmlTag& pStartTag,
+                                        OperationType pType)
+{
+    TRACE(4, "XmlDedicatedParser::parseOperation");
+
+    Symbol entity;
+    XmlTag tag;
+    while (!pStartTag.isEmpty)
+    {
+        nextTag(tag);
+        if (tag.isEnd)
+        {
+            checkEndTag(tag, pStartTag);
+            break;
+        }
+
+        if (tagNameEq(tag, "ENTITY"))
+        {
+            if (!tag.isEmpty)
+            {
+                text(mText);
+                endTag(tag);
+            }
+            else
+            {
+                mText.clear();
+            }
+            entity = Symbol(mText);
+            TRACE_MSG("Parsed ENTITY: " + mText);
+        }
+        else if (tagNameEq(tag, "KEY"))
+        {
+            delete mOperationKey;
+            mOperationKey = new ColumnValueSet;
+            parseValueSet(tag, *mOperationKey);
+        }
+        else if (tagNameEq(tag, "VALUE"))
+        {
+            delete mOperationValue;
+            mOperationValue = new ColumnValueSet;
+            parseValueSet(tag, *mOperationValue);
+        }
+        else
+        {
+            throw(std::runtime_error( "Invalid operation field tag found: " + tagName(tag)));
+        }
+    }
+
+    // all needed values collected
+    if (!mBatchKey)
+    {
+        throw(std::runtime_error( "BATCH KEY missing" ));
+    }
+    if (!mOperationKey)
+    {
+        throw(std::runtime_error( convertOperationType2string(pType) + " KEY missing" ));
+    }
+
+    // the key is taken over only by a new batch
+    TRACE_MSG("Registering " + convertOperationType2string(pType) + " on entity: " + entity.getName());
+    bool isKeyTaken = false;
+    Operation* operation = mLog->sqlOperation(mBatchKey, pType, entity, &isKeyTaken);
+    if (isKeyTaken)
+    {
+        mIsBatchKeyOwned = false;
+    }
+    operation->addKeySet(mOperationKey);                 // values taken over
+    if (pType == DELETE)
+    {
+        operation->addValueSet(mOperationValue, NULL);   // values taken over
+    }
+    else
+    {
+        operation->addValueSet(NULL, mOperationValue);   // values taken over
+    }
+    delete mOperationKey;
+    delete mOperationValue;
+    mOperationKey = NULL;
+    mOperationValue = NULL;
+}
+
+// columns: <label TypeId="n">value</label>
+void XmlDedicatedParser::parseValueSet(const XmlTag&   pStartTag,
+                                       ColumnValueSet& pValueSet)
+{
+    TRACE(4, "XmlDedicatedParser::parseValueSet");
+
+    XmlTag tag;
+    while (!pStartTag.isEmpty)
+    {
+        nextTag(tag);
+        if (tag.isEnd)
+        {
+            checkEndTag(tag, pStartTag);
+            break;
+        }
+
+        int typeId = 0;
+        for (size_t i = 0; i < tag.typeIdLength; i++)
+        {
+            if (tag.typeId[i] < '0' || tag.typeId[i] > '9')
+            {
+                throw(invalid_argument("Invalid TypeId value: " + string(tag.typeId, tag.typeIdLength)));
+            }
+            typeId = typeId * 10 + (tag.typeId[i] - '0');
+        }
+
+        if (!tag.isEmpty)
+        {
+            text(mText);
+            endTag(tag);
+        }
+        else
+        {
+            mText.clear();
+        }
+
+        Symbol label(tag.name, tag.nameLength);
+        pValueSet.addValue(pValueSet.sqlValue((SqlValueType)typeId, label, mText));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// DoLog::xmlDedicatedParse
+////////////////////////////////////////////////////////////////////////////////
+
+// nothing is registered if the document is not in the subset read
+bool DoLog::xmlDedicatedParse(const unsigned char* pBuffer,
+                              const size_t         pBufferLength)
+{
+    TRACE(4, "DoLog::xmlDedicatedParse");
+
+    const char* begin = (const char *)pBuffer;
+    const char* end = begin + pBufferLength;
+    if (!isDedicatedSubset(begin, end))
+    {
+        TRACE_MSG("XML document left to Xerces");
+        return false;
+    }
+
+    XmlDedicatedParser parser(this, begin, end);
+    parser.parse();
+
+    return true;
+}
+
+}
@@ -24,7 +24,9 @@
 // Description: Implementation of XML parsing method of class DoLog.
 // Author(s)  : Norbert Bondarczuk
 // Created    : 2015-01-08
-// Abstract   : Implementation of XML parsing method of class DoLog.
+// Abstract   : Implementation of XML parsing method of class DoLog. The document
+//              is streamed with SAX2 parser, each batch is registered as soon
+//              as its element is closed.
 //
 ///////////////////////////////////////////////////////////////////////////////
 /*
@@ -32,20 +34,21 @@
  */
 
 #include <string>
-#include <iostream>
-#include <map>
-#include <list>
+#include <vector>
 #include <stdexcept>
-#include <sstream>
 
 #include <stdio.h>
-#include <xercesc/parsers/XercesDOMParser.hpp>
-#include <xercesc/dom/DOM.hpp>
-#include <xercesc/sax/HandlerBase.hpp>
+#include <pthread.h>
+#include <xercesc/sax2/SAX2XMLReader.hpp>
+#include <xercesc/sax2/XMLReaderFactory.hpp>
+#include <xercesc/sax2/DefaultHandler.hpp>
+#include <xercesc/sax2/Attributes.hpp>
+#include <xercesc/sax/SAXParseException.hpp>
 #include <xercesc/util/XMLString.hpp>
+#include <xercesc/util/XMLUniDefs.hpp>
+#include <xercesc/util/XMLUni.hpp>
 #include <xercesc/util/PlatformUtils.hpp>
 #include <xercesc/framework/MemBufInputSource.hpp>
-#include <string>
 
 #include "DoLogTerminationHandler.hpp"
 #include "DoLogComponentController.hpp"
@@ -61,543 +64,409 @@ namespace dolog
 {
 
 ////////////////////////////////////////////////////////////////////////////////
-// mandatory Xerces objects: error handler and container
+// Xerces platform initialized once for the whole process
 ////////////////////////////////////////////////////////////////////////////////
 
-//
-// xercesc exception & error handling
-//
+static pthread_once_t sXercesOnce = PTHREAD_ONCE_INIT;
 
-class XmlDomErrorHandler : public HandlerBase
+static void xercesInitialize()
 {
-public:
-    void fatalError(const SAXParseException &pException);
-private:
-    bool mIsParserError;
-    char mParserErrmsg[MAX_PARSER_ERRMSG_LEN + 1];
+    XMLPlatformUtils::Initialize();
+}
+
+// name of the attribute with type of SQL value
+static const XMLCh sTypeIdLabel[] =
+{
+    chLatin_T, chLatin_y, chLatin_p, chLatin_e, chLatin_I, chLatin_d, chNull
 };
 
-void XmlDomErrorHandler:: fatalError(const SAXParseException &pException)
+// the function converts Xerces string into a standard readable format
+static string xmlCh2string(const XMLCh* pXmlChValue)
 {
-    sprintf(mParserErrmsg, "Fatal parsing error at line %d", (int)pException.getLineNumber());
-    mIsParserError = true;
+    char* labelTrans = XMLString::transcode(pXmlChValue);
+    string label(labelTrans);
+    XMLString::release(&labelTrans);
+    return label;
 }
 
-//
-// xercesc XML Document container
-//
+////////////////////////////////////////////////////////////////////////////////
+// UndologSaxHandler: state of parsing of one document. The elements are
+// expected on fixed levels:
+// 1. UNDOLOG
+// 2. BATCH
+// 3. DIGEST KEY INSERT UPDATE DELETE
+// 4. ENTITY KEY VALUE of the operation or columns of the batch KEY
+// 5. columns of the operation KEY or VALUE
+// Only the operation being parsed is kept, it is registered in the log upon
+// its end tag. The batch is handed over to the log upon end tag of BATCH.
+////////////////////////////////////////////////////////////////////////////////
 
-class XmlDomDocument
+class UndologSaxHandler : public DefaultHandler
 {
 public:
-    XmlDomDocument(const unsigned char* pXmlString,
-                   const size_t pXmlStringLength);
-    ~XmlDomDocument();
-    DOMDocument* getDocument();
+    UndologSaxHandler(DoLog* pLog);
+    ~UndologSaxHandler();
+    void startElement(const XMLCh* const pUri,
+                      const XMLCh* const pLocalName,
+                      const XMLCh* const pQName,
+                      const Attributes&  pAttributes);
+    void endElement(const XMLCh* const pUri,
+                    const XMLCh* const pLocalName,
+                    const XMLCh* const pQName);
+    void characters(const XMLCh* const pChars,
+                    const XMLSize_t    pLength);
+    void fatalError(const SAXParseException& pException);
 private:
-    XmlDomDocument();
-    XmlDomDocument(const class XmlDOMDocument&);
-    void tryCreateParser();
-    static class XercesDOMParser* sParser;
-    static class ErrorHandler*    sErrorHandler;
-    DOMDocument*                  mXmlDocument;
+    UndologSaxHandler(const UndologSaxHandler&);
+    void              startBatchElement(const string& pLabel);
+    void              startOperationElement(const string& pLabel);
+    void              endOperation();
+    string            text();
+    DoLog*            mLog;
+    int               mDepth;
+    int               mSkipDepth;           // content ignored below, 0 - none
+    ColumnValueSet*   mBatchKey;            // last recently found batch key
+    bool              mIsBatchKeyOwned;     // not taken over by any batch yet
+    bool              mIsOperation;         // INSERT UPDATE DELETE being parsed
+    OperationType     mOperationType;
+    string            mEntity;
+    ColumnValueSet*   mOperationKey;
+    ColumnValueSet*   mOperationValue;
+    ColumnValueSet*   mValueSet;            // KEY or VALUE being parsed
+    int               mValueSetDepth;
+    string            mColumnLabel;
+    string            mColumnTypeId;
+    bool              mIsText;              // text of the element collected
+    vector<XMLCh>     mText;
 };
 
-DOMDocument* XmlDomDocument::getDocument()
+UndologSaxHandler::UndologSaxHandler(DoLog* pLog) : mLog(pLog),
+                                                    mDepth(0),
+                                                    mSkipDepth(0),
+                                                    mBatchKey(NULL),
+                                                    mIsBatchKeyOwned(false),
+                                                    mIsOperation(false),
+                                                    mOperationType(INSERT),
+                                                    mOperationKey(NULL),
+                                                    mOperationValue(NULL),
+                                                    mValueSet(NULL),
+                                                    mValueSetDepth(0),
+                                                    mIsText(false)
 {
-    return mXmlDocument;
 }
 
-class XercesDOMParser* XmlDomDocument::sParser       = NULL;
-class ErrorHandler*    XmlDomDocument::sErrorHandler = NULL;
-
-// create XML parser upon first call
-void XmlDomDocument::tryCreateParser()
+// the values of the batch or operation not completed due to an error, the
+// value set being parsed is one of them
+UndologSaxHandler::~UndologSaxHandler()
 {
-    if (!sParser)
+    if (mIsBatchKeyOwned)
     {
-        XMLPlatformUtils::Initialize();
-        sParser = new XercesDOMParser();
-        sErrorHandler = (ErrorHandler*) new XmlDomErrorHandler();
-        sParser->setErrorHandler(sErrorHandler);
+        delete mBatchKey;
     }
+    delete mOperationKey;
+    delete mOperationValue;
 }
 
-// perform parsing of XML document
-XmlDomDocument::XmlDomDocument(const unsigned char* pXmlImage,
-                               const size_t pXmlImageLength) : mXmlDocument(NULL)
+void UndologSaxHandler::startElement(const XMLCh* const pUri,
+                                     const XMLCh* const pLocalName,
+                                     const XMLCh* const pQName,
+                                     const Attributes&  pAttributes)
 {
-    tryCreateParser();
-    MemBufInputSource xmlBuffer(pXmlImage, pXmlImageLength, "xml (in memory)");
-    sParser->parse(xmlBuffer);
-    mXmlDocument = sParser->getDocument();
-}
+    TRACE(4, "UndologSaxHandler::startElement");
 
-// XML document instance was processed - memory may be relased
-XmlDomDocument::~XmlDomDocument()
-{
-    if (mXmlDocument)
+    mDepth++;
+    if (mSkipDepth)
     {
-        mXmlDocument->release();
+        return;
     }
-}
 
-////////////////////////////////////////////////////////////////////////////////
-// using Xerrces parser dom objects
-////////////////////////////////////////////////////////////////////////////////
+    string label = xmlCh2string(pQName);
+    TRACE_MSG("XML Parser: found element: " + label);
 
-// last recently found batch key to be used across the whole call stack of parser
-// functions
-static ColumnValueSet* sBatchKey = NULL;
+    // column of the KEY or VALUE with its type
+    if (mValueSet)
+    {
+        if (mDepth == mValueSetDepth + 1)
+        {
+            mColumnLabel = label;
+            const XMLCh* typeId = pAttributes.getValue(sTypeIdLabel);
+            mColumnTypeId = typeId ? xmlCh2string(typeId) : string();
+            mText.clear();
+            mIsText = true;
+        }
+        else
+        {
+            // no deeper structure of the column value
+            mIsText = false;
+        }
+        return;
+    }
 
-// the function converts XALAN string into a standard readable format
-string xmlCh2string(const XMLCh* pXmlChValue)
-{
-    char* labelTrans = XMLString::transcode(pXmlChValue);
-    string label(labelTrans);
-    XMLString::release(&labelTrans);
-    return label;
-}
+    switch (mDepth)
+    {
+        case 1:
+            if (label != "UNDOLOG")
+            {
+                throw(std::runtime_error( "XML document level 1 root element not UNDOLOG" ));
+            }
+            break;
 
-// the fucntion checks is the DOM element label is matching the string
-bool elementTagNameEq(DOMElement* pElement,
-                      std::string pLabelQuery)
-{
-    TRACE(4, "elementTagNameEq");
+        case 2:
+            if (label != "BATCH")
+            {
+                throw(std::runtime_error( "XML document level 2 element not BATCH" ));
+            }
+            break;
 
-    TRACE_MSG("Tesing element label: " + pLabelQuery);
+        case 3:
+            startBatchElement(label);
+            break;
 
-    if( !pElement )
-    {
-        throw(std::runtime_error( "Empty XML document element" ));
-    }
+        case 4:
+            startOperationElement(label);
+            break;
 
-    string label = xmlCh2string(pElement->getTagName());
-    TRACE_MSG("Element label is: " + label);
-    if (label != pLabelQuery)
-    {
-        return false;
+        default:
+            throw(std::runtime_error( "Invalid element found: " + label));
     }
-
-    return true;
 }
 
-// the functions gets the number of sub-elements of a DOM element
-// and their number
-DOMNodeList* childNodeListGet(const DOMElement* pElement,
-                              XMLSize_t& pElementListLength)
+// DIGEST KEY INSERT UPDATE DELETE
+void UndologSaxHandler::startBatchElement(const string& pLabel)
 {
-    DOMNodeList* nodeList = pElement->getChildNodes();
-    const XMLSize_t nodeListLength = nodeList->getLength();
-    if ( nodeListLength  == 0 )
+    if (pLabel == "DIGEST")
     {
-        throw(std::runtime_error( "Empty XML node list" ));
+        // NOP - digest not needed
+        mSkipDepth = mDepth;
     }
-
-    pElementListLength = nodeListLength;
-    return nodeList;
-}
-
-// the function gets the ENTITY tag for a given DOM element
-void xmlParseBatchOperationEntity(DOMElement* pElement,
-                                  string& pEntityLabel)
-{
-    TRACE(4, "xmlParseBatchOperationEntity");
-
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(pElement, nodeListLength);
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
+    else if (pLabel == "KEY")
     {
-        DOMNode* node = nodeList->item(i);
-        if (node &&
-            node->getNodeType() == DOMNode::TEXT_NODE )
+        if (mBatchKey)
         {
-            pEntityLabel = xmlCh2string(node->getNodeValue());
-            break;
+            throw(std::runtime_error( "BATCH KEY repeated" ));
         }
+        mBatchKey = new ColumnValueSet;
+        mIsBatchKeyOwned = true;
+        mValueSet = mBatchKey;
+        mValueSetDepth = mDepth;
     }
-}
-
-// the function gets the value of a DOM element where KEY/VALUE
-// pairs are stored for each SQL attribute stored in XML
-string xmlParseBatchOperationKeyValue(DOMElement* pElement)
-{
-    TRACE(4, "DoLog::xmlParseBatchOperationKeyValue");
-
-    string value;
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList;
-
-    nodeList = childNodeListGet(pElement, nodeListLength);
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
+    else
     {
-        DOMNode* node = nodeList->item(i);
-        if (node &&
-            node->getNodeType() == DOMNode::TEXT_NODE)
+        if (pLabel == "INSERT")
         {
-            value = xmlCh2string(node->getNodeValue());
-            break;
+            mOperationType = INSERT;
+        }
+        else if (pLabel == "UPDATE")
+        {
+            mOperationType = UPDATE;
+        }
+        else if (pLabel == "DELETE")
+        {
+            mOperationType = DELETE;
+        }
+        else
+        {
+            throw(std::runtime_error( "Invalid element found: " + pLabel));
         }
+        mIsOperation = true;
+        mEntity.clear();
     }
-
-    return value;
 }
 
-// the function gets the attribute of a given DOM element by it's name
-// the deoding from XALAN format of strings is done here
-string xmlParseBatchOperationKeyValueAttribute(DOMElement* pElement,
-                                               string pAttributeLabel)
+// ENTITY KEY VALUE
+void UndologSaxHandler::startOperationElement(const string& pLabel)
 {
-    TRACE(4, "xmlParseBatchOperationKeyValueAttribute");
-
-    string attributeValue;
-    XMLCh* chAttributeLabel = XMLString::transcode(pAttributeLabel.c_str());
-    const XMLCh* chAttributeValue = pElement->getAttribute(chAttributeLabel);
-    if (chAttributeValue)
+    if (!mIsOperation)
     {
-        attributeValue = xmlCh2string(chAttributeValue);
+        throw(std::runtime_error( "Invalid element found: " + pLabel));
     }
-    XMLString::release(&chAttributeLabel);
-    return attributeValue;
-}
 
-// the function parses a sequence of SQL values starting with a list
-// of KEYs of VALUEs
-ColumnValueSet* xmlParseBatchOperationArg(DOMElement* pElement)
-{
-    TRACE(4, "DoLog::xmlParseBatchOperationArg");
-
-    ColumnValueSet* columnValueSet = new ColumnValueSet;
-    SqlValue* sqlValue = NULL;
-
-    // KEY or VALUE
-    if (!elementTagNameEq(pElement, "KEY") &&
-        !elementTagNameEq(pElement, "VALUE"))
+    if (pLabel == "ENTITY")
     {
-        throw(std::runtime_error( "XML element neither KEY nor VALUE" ));
+        mText.clear();
+        mIsText = true;
     }
-
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(pElement, nodeListLength);
-    TRACE_MSG("KEY/VALUE: Found sub-nodes: " + any2string(nodeListLength));
-
-    // for each sub-node: list of column names with values add to a set
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
+    else if (pLabel == "KEY")
     {
-        DOMNode* node = nodeList->item(i);
-        if (node &&
-            node->getNodeType() == DOMNode::ELEMENT_NODE )
-        {
-            string label  = xmlCh2string(node->getNodeName());
-            string valueString  = xmlParseBatchOperationKeyValue(dynamic_cast< xercesc::DOMElement* >(node));
-            string typeId = xmlParseBatchOperationKeyValueAttribute(dynamic_cast< xercesc::DOMElement* >(node), "TypeId");
-            TRACE_MSG(label + " = " + valueString + " - TypeId: " + typeId);
-            sqlValue = columnValueSet->sqlValue(typeId, label, valueString);
-            columnValueSet->addValue(sqlValue);
-        }
+        delete mOperationKey;
+        mOperationKey = new ColumnValueSet;
+        mValueSet = mOperationKey;
+        mValueSetDepth = mDepth;
+    }
+    else if (pLabel == "VALUE")
+    {
+        delete mOperationValue;
+        mOperationValue = new ColumnValueSet;
+        mValueSet = mOperationValue;
+        mValueSetDepth = mDepth;
+    }
+    else
+    {
+        throw(std::runtime_error( "Invalid operation field tag found: " + pLabel));
     }
-
-    // new set of labeled values
-    return columnValueSet;
 }
 
-// the function parses the DOM element with type INSERT
-void xmlParseBatchOperationInsert(DOMElement* pElement)
+void UndologSaxHandler::endElement(const XMLCh* const pUri,
+                                   const XMLCh* const pLocalName,
+                                   const XMLCh* const pQName)
 {
-    TRACE(4, "DoLog::xmlParseBatchOperationInsert");
-
-    string entityLabel;
-    ColumnValueSet* operationKey = NULL;
-    ColumnValueSet* operationValueAfter = NULL;
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(pElement, nodeListLength);
-    TRACE_MSG("INSERT: Found sub-nodes: " + any2string(nodeListLength));
+    TRACE(4, "UndologSaxHandler::endElement");
 
-    // for each sub-node: ENTITY KEY VALUE
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
+    int depth = mDepth--;
+    if (mSkipDepth)
     {
-        DOMNode* node = nodeList->item(i);
-        if(node &&
-           node->getNodeType() == DOMNode::ELEMENT_NODE )
+        if (depth == mSkipDepth)
         {
-            DOMElement* elementOfNode = dynamic_cast< xercesc::DOMElement* >(node);
-            if (!elementOfNode)
-            {
-                throw(std::runtime_error( "Empty XML element OPERATION" ));
-            }
-
-            string label = xmlCh2string(elementOfNode->getTagName());
-            if (label == "ENTITY")
-            {
-                xmlParseBatchOperationEntity(elementOfNode, entityLabel);
-                TRACE_MSG("Entity: " + entityLabel);
-            }
-            else if (label == "KEY")
-            {
-                operationKey = xmlParseBatchOperationArg(elementOfNode);
-                TRACE_MSG("Parsed KEY");
-            }
-            else if (label == "VALUE")
-            {
-                operationValueAfter = xmlParseBatchOperationArg(elementOfNode);
-                TRACE_MSG("Parsed VALUE");
-            }
-            else
-            {
-                throw(std::runtime_error( "Invalid operation field tag found: " + label));
-            }
+            mSkipDepth = 0;
         }
+        return;
     }
 
-    // all needed values collected
-    TRACE_MSG("Registering INSERT on entity: " + entityLabel);
-    Operation* operation = DoLog::getInstance()->sqlOperation(sBatchKey, INSERT, entityLabel);
-    operation->addKeySet(operationKey);            // deep copy
-    operation->addValueSet(NULL, operationValueAfter); // deep copy
-    delete operationKey;
-    delete operationValueAfter;
-    TRACE_MSG("Registered INSERT on entity: " + entityLabel);
-}
-
-// the function parses the DOM element with type UPDATE
-void xmlParseBatchOperationUpdate(DOMElement* pElement)
-{
-    TRACE(4, "DoLog::xmlParseBatchOperationUpdate");
-
-    string entityLabel;
-    ColumnValueSet* operationKey = NULL;
-    ColumnValueSet* operationValueAfter = NULL;
-
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(pElement, nodeListLength);
-    TRACE_MSG("UPDATE: Found sub-nodes: " + any2string(nodeListLength));
-
-    // for each sub-node: ENTITY KEY VALUE
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
+    if (mValueSet)
     {
-        DOMNode* node = nodeList->item(i);
-        if(node &&
-           node->getNodeType() == DOMNode::ELEMENT_NODE )
+        if (depth == mValueSetDepth + 1)
         {
-            DOMElement* elementOfNode = dynamic_cast< xercesc::DOMElement* >(node);
-            if (!elementOfNode)
-            {
-                throw(std::runtime_error( "Empty XML element OPERATION" ));
-            }
-
-            string label = xmlCh2string(elementOfNode->getTagName());
-            if (label == "ENTITY")
-            {
-                xmlParseBatchOperationEntity(elementOfNode, entityLabel);
-                TRACE_MSG("Parsed ENTITY: " + entityLabel);
-            }
-            else if (label == "KEY")
-            {
-                operationKey = xmlParseBatchOperationArg(elementOfNode);
-                TRACE_MSG("Parsed KEY");
-            }
-            else if (label == "VALUE")
-            {
-                operationValueAfter = xmlParseBatchOperationArg(elementOfNode);
-                TRACE_MSG("Parsed VALUE");
-            }
-            else
-            {
-                throw(std::runtime_error( "Invalid operation field tag found: " + label));
-            }
+            // column completed
+            string value = text();
+            TRACE_MSG(mColumnLabel + " = " + value + " - TypeId: " + mColumnTypeId);
+            mValueSet->addValue(mValueSet->sqlValue(mColumnTypeId, mColumnLabel, value));
+        }
+        else if (depth == mValueSetDepth)
+        {
+            // KEY or VALUE completed
+            mValueSet = NULL;
         }
+        return;
     }
 
-    // all needed values collected
-    TRACE_MSG("Registering UPDATE on entity: " + entityLabel);
-    Operation* operation = DoLog::getInstance()->sqlOperation(sBatchKey, UPDATE, entityLabel);
-    operation->addKeySet(operationKey);                // deep copy
-    operation->addValueSet(NULL, operationValueAfter); // deep copy
-    delete operationKey;
-    delete operationValueAfter;
-    TRACE_MSG("Registered UPDATE on entity: " + entityLabel);
-}
-
-// the function parses the DOM element with type DELETE
-void xmlParseBatchOperationDelete(DOMElement* pElement)
-{
-    TRACE(4, "DoLog::xmlParseBatchOperationDelete");
-
-    string entityLabel;
-    ColumnValueSet* operationKey = NULL;
-    ColumnValueSet* operationValueBefore = NULL;
-    ColumnValueSet* operationValueAfter = NULL;
-
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(pElement, nodeListLength);
-    TRACE_MSG("DELETE: Found sub-nodes: " + any2string(nodeListLength));
-
-    // for each sub-node: ENTITY KEY VALUE
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
+    if (depth == 4 && mIsText)
+    {
+        mEntity = text();
+        TRACE_MSG("Parsed ENTITY: " + mEntity);
+    }
+    else if (depth == 3 && mIsOperation)
     {
-        DOMNode* node = nodeList->item(i);
-        if (node &&
-            node->getNodeType() == DOMNode::ELEMENT_NODE )
+        endOperation();
+    }
+    else if (depth == 2)
+    {
+        // the key was taken over by the batch unless no operation used it
+        mLog->batchLoaded(mBatchKey);
+        if (mIsBatchKeyOwned)
         {
-            TRACE_MSG("Parsing next element");
-            DOMElement* elementOfNode = dynamic_cast< xercesc::DOMElement* >(node);
-            if (!elementOfNode)
-            {
-                throw(std::runtime_error( "Empty XML element OPERATION" ));
-            }
-            string label = xmlCh2string(elementOfNode->getTagName());
-            if (label == "ENTITY")
-            {
-                xmlParseBatchOperationEntity(elementOfNode, entityLabel);
-                TRACE_MSG("Parsed ENTITY: " + entityLabel);
-            }
-            else if (label == "KEY")
-            {
-                operationKey = xmlParseBatchOperationArg(elementOfNode);
-                TRACE_MSG("Parsed KEY");
-            }
-            else if (label == "VALUE")
-            {
-                operationValueBefore = xmlParseBatchOperationArg(elementOfNode);
-                TRACE_MSG("Parsed VALUE");
-            }
-            else
-            {
-                throw(std::runtime_error( "Invalid operation field tag found: " + label));
-            }
+            delete mBatchKey;
         }
+        mBatchKey = NULL;
+        mIsBatchKeyOwned = false;
     }
-
-    // all needed values collected
-    TRACE_MSG("Registering DELETE on entity: " + entityLabel);
-    Operation* operation = DoLog::getInstance()->sqlOperation(sBatchKey, DELETE, entityLabel);
-    operation->addKeySet(operationKey);                  // deep copy
-    operation->addValueSet(operationValueBefore, NULL);  // deep copy
-    delete operationKey;
-    delete operationValueBefore;
-    TRACE_MSG("Registered DELETE on entity: " + entityLabel);
 }
 
-// the function parses the DOM element with any type of operation
-// it starts proper handler foea each type of operation
-void xmlParseBatchOperation(DOMElement* pElement)
+// all needed values collected, the operation is registered in the batch
+void UndologSaxHandler::endOperation()
 {
-    TRACE(4, "DoLog::xmlParseBatchOperation");
+    TRACE(4, "UndologSaxHandler::endOperation");
 
-    // DIGEST KEY INSERT UPDATE DELETE
-    if (!pElement)
-    {
-        throw(std::runtime_error( "Empty XML element BATCH" ));
-    }
-    string label = xmlCh2string(pElement->getTagName());
-    TRACE_MSG("XML Parser: found element: " + label);
-
-    if (label == "DIGEST")
-    {
-        // NOP - digest not needed
-    }
-    else if (label == "KEY")
+    if (!mBatchKey)
     {
-        sBatchKey = xmlParseBatchOperationArg(pElement);
+        throw(std::runtime_error( "BATCH KEY missing" ));
     }
-    else if (label == "INSERT")
+    if (!mOperationKey)
     {
-        xmlParseBatchOperationInsert(pElement);
+        throw(std::runtime_error( convertOperationType2string(mOperationType) + " KEY missing" ));
     }
-    else if (label == "UPDATE")
+
+    // the key is taken over only by a new batch
+    TRACE_MSG("Registering " + convertOperationType2string(mOperationType) + " on entity: " + mEntity);
+    bool isKeyTaken = false;
+    Operation* operation = mLog->sqlOperation(mBatchKey, mOperationType, mEntity, &isKeyTaken);
+    if (isKeyTaken)
     {
-        xmlParseBatchOperationUpdate(pElement);
+        mIsBatchKeyOwned = false;
     }
-    else if (label == "DELETE")
+    operation->addKeySet(mOperationKey);                     // values taken over
+    if (mOperationType == DELETE)
     {
-        xmlParseBatchOperationDelete(pElement);
+        operation->addValueSet(mOperationValue, NULL);       // values taken over
     }
     else
     {
-        throw(std::runtime_error( "Invalid element found: " + label));
+        operation->addValueSet(NULL, mOperationValue);       // values taken over
     }
+    delete mOperationKey;
+    delete mOperationValue;
+    mOperationKey = NULL;
+    mOperationValue = NULL;
+    mIsOperation = false;
 }
 
-// the function parses a DOM element of type BATCH
-// it also validates if it was callsed with the right element
-void xmlParseBatch(DOMElement* pElement)
+// the text may be reported in many pieces
+void UndologSaxHandler::characters(const XMLCh* const pChars,
+                                   const XMLSize_t    pLength)
 {
-    TRACE(4, "DoLog::xmlParseBatch");
-
-    // BATCH
-    if (!elementTagNameEq(pElement, "BATCH"))
+    if (mIsText && !mSkipDepth)
     {
-        throw(std::runtime_error( "XML document level 2 element not BATCH" ));
-    }
-
-    // start building next batch
-
-    sBatchKey = NULL;
-
-    // for each sub-node DIGEST KEY INSERT UPDATE DELETE
-
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(pElement, nodeListLength);
-    TRACE_MSG("BATCH: Found sub-nodes: " + any2string(nodeListLength));
-
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
-    {
-        DOMNode* node = nodeList->item(i);
-        if (node &&
-            node->getNodeType() == DOMNode::ELEMENT_NODE )
-        {
-            xmlParseBatchOperation(dynamic_cast< xercesc::DOMElement* >(node));
-        }
+        mText.insert(mText.end(), pChars, pChars + pLength);
     }
 }
 
-// the function parses a DOM element of type UNDOLOG
-// it also validates if it was callsed with the right element
-void xmlParseUndolog(DOMDocument *pDocument)
+// text of the element just closed
+string UndologSaxHandler::text()
 {
-    TRACE(4, "DoLog::xmlParseUndolog");
-
-    if( !pDocument )
-    {
-        throw(std::runtime_error( "Empty XML document" ));
-    }
-
-    DOMElement* element = pDocument->getDocumentElement();
-
-    // UNDOLOG
-    if (!elementTagNameEq(element, "UNDOLOG"))
+    mIsText = false;
+    if (mText.empty())
     {
-        throw(std::runtime_error( "XML document level 1 root element not UNDOLOG" ));
+        return string();
     }
 
-    // for each sub-node: BATCH
-    XMLSize_t nodeListLength;
-    DOMNodeList* nodeList = childNodeListGet(element, nodeListLength);
-    TRACE_MSG("UNDOLOG: Found sub-nodes: " + any2string(nodeListLength));
+    mText.push_back(chNull);
+    return xmlCh2string(&mText[0]);
+}
 
-    for( XMLSize_t i = 0; i < nodeListLength; i++ )
-    {
-        DOMNode* node = nodeList->item(i);
-        if( node &&
-            node->getNodeType() == DOMNode::ELEMENT_NODE )
-        {
-            xmlParseBatch(dynamic_cast< xercesc::DOMElement* >(node));
-        }
-    }
+void UndologSaxHandler::fatalError(const SAXParseException &pException)
+{
+    char errmsg[MAX_PARSER_ERRMSG_LEN + 1];
+    sprintf(errmsg, "Fatal parsing error at line %d", (int)pException.getLineNumber());
+    throw(std::runtime_error(errmsg));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // DoLog::xmlParse
 ////////////////////////////////////////////////////////////////////////////////
 
+// the document is read in place, no tree of it is built; each parse has its
+// own reader so the contexts of many threads may load at once
 void DoLog::xmlParse(const unsigned char *pBuffer,
                      const size_t pBufferLength)
 {
     TRACE(4, "DoLog::xmlParse");
 
-    XmlDomDocument* document = new XmlDomDocument(pBuffer, pBufferLength);
-    xmlParseUndolog(document->getDocument());
-    delete document;
+    if (mXmlParser == XML_PARSER_DEDICATED &&
+        xmlDedicatedParse(pBuffer, pBufferLength))
+    {
+        return;
+    }
+
+    pthread_once(&sXercesOnce, xercesInitialize);
+
+    UndologSaxHandler handler(this);
+    SAX2XMLReader* reader = XMLReaderFactory::createXMLReader();
+    reader->setFeature(XMLUni::fgSAX2CoreValidation, false);
+    reader->setFeature(XMLUni::fgXercesLoadExternalDTD, false);
+    reader->setContentHandler(&handler);
+    reader->setErrorHandler(&handler);
+
+    try
+    {
+        MemBufInputSource xmlBuffer(pBuffer, pBufferLength, "xml (in memory)");
+        reader->parse(xmlBuffer);
+    }
+    catch (...)
+    {
+        delete reader;
+        throw;
+    }
+
+    delete reader;
 }
 
 }
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogXmlSink.cpp
+// Description: Implementation of append only output buffers used for rendering
+//              of the XML image of the log.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-02
+// Abstract   : Implementation of XML output sinks.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#include <string>
+#include <iostream>
+#include <stdexcept>
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "DoLogXmlSink.hpp"
+
+using namespace std;
+
+namespace dolog
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// XmlSink
+////////////////////////////////////////////////////////////////////////////////
+
+XmlSink::~XmlSink()
+{}
+
+XmlSink& XmlSink::operator<<(const string& pString)
+{
+    write(pString.data(), pString.length());
+    return *this;
+}
+
+XmlSink& XmlSink::operator<<(const char* pString)
+{
+    write(pString, strlen(pString));
+    return *this;
+}
+
+XmlSink& XmlSink::operator<<(char pChar)
+{
+    write(&pChar, 1);
+    return *this;
+}
+
+XmlSink& XmlSink::operator<<(int pValue)
+{
+    char buffer[16];
+    int length = snprintf(buffer, sizeof(buffer), "%d", pValue);
+    write(buffer, length);
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// XmlFileSink
+////////////////////////////////////////////////////////////////////////////////
+
+XmlFileSink::XmlFileSink(ostream& pOutput) : mOutput(pOutput)
+{}
+
+void XmlFileSink::write(const char* pData,
+                        size_t      pLength)
+{
+    mOutput.write(pData, pLength);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// XmlMemorySink
+////////////////////////////////////////////////////////////////////////////////
+
+XmlMemorySink::XmlMemorySink(size_t pHeaderSize)
+    : mBuffer(NULL),
+      mHeaderSize(pHeaderSize),
+      mLength(0),
+      mCapacity(0)
+{}
+
+XmlMemorySink::~XmlMemorySink()
+{
+    free(mBuffer);
+}
+
+// the buffer may only grow, it is reused by consecutive images
+void XmlMemorySink::reserve(size_t pSize)
+{
+    if (pSize > mCapacity)
+    {
+        size_t capacity = mCapacity > 0 ? mCapacity : 4096;
+        while (capacity < pSize)
+        {
+            capacity *= 2;
+        }
+
+        char* buffer = (char *)realloc(mBuffer, mHeaderSize + capacity);
+        if (buffer == NULL)
+        {
+            char msg[64];
+            snprintf(msg, sizeof(msg), "Unable allocate XML buffer of size: %lu",
+                     (unsigned long)(mHeaderSize + capacity));
+            throw(runtime_error(msg));
+        }
+
+        mBuffer = buffer;
+        mCapacity = capacity;
+    }
+}
+
+void XmlMemorySink::write(const char* pData,
+                          size_t      pLength)
+{
+    reserve(mLength + pLength);
+    memcpy(mBuffer + mHeaderSize + mLength, pData, pLength);
+    mLength += pLength;
+}
+
+// start next image in the same memory
+void XmlMemorySink::clear()
+{
+    mLength = 0;
+}
+
+const char* XmlMemorySink::data()
+{
+    reserve(1);
+    return mBuffer + mHeaderSize;
+}
+
+size_t XmlMemorySink::length()
+{
+    return mLength;
+}
+
+char* XmlMemorySink::buffer()
+{
+    reserve(1);
+    return mBuffer;
+}
+
+size_t XmlMemorySink::capacity()
+{
+    return mCapacity;
+}
+
+string XmlMemorySink::str()
+{
+    return string(data(), mLength);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// XmlFixedSink
+////////////////////////////////////////////////////////////////////////////////
+
+XmlFixedSink::XmlFixedSink(char*  pBuffer,
+                           size_t pCapacity)
+    : mBuffer(pBuffer),
+      mLength(0),
+      mCapacity(pCapacity),
+      mIsOverflow(false)
+{}
+
+// after overflow the rest of the image is ignored
+void XmlFixedSink::write(const char* pData,
+                         size_t      pLength)
+{
+    if (mIsOverflow || mLength + pLength > mCapacity)
+    {
+        mIsOverflow = true;
+        return;
+    }
+
+    memcpy(mBuffer + mLength, pData, pLength);
+    mLength += pLength;
+}
+
+size_t XmlFixedSink::length()
+{
+    return mLength;
+}
+
+bool XmlFixedSink::isOverflow()
+{
+    return mIsOverflow;
+}
+
+}
@@ -0,0 +1,147 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogXmlParseBench.cpp
+// Description: Benchmark of the XML parsers used upon load.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-04-02
+// Abstract   : Loads the same UNDOLOG file with the Xerces and the dedicated
+//              parser and reports the time of both. The UNDO image of both
+//              loads is compared so the times refer to the same result.
+//              Not part of the library build, linked with its objects:
+//              DoLogXmlParseBench <file> [rounds]
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#include <string>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "DoLogTerminationHandler.hpp"
+#include "DoLogComponentController.hpp"
+#include "DoLogTrace.hpp"
+#include "DoLogSqlValue.hpp"
+#include "DoLog.hpp"
+
+using namespace std;
+using namespace dolog;
+
+// default number of loads of the file by each parser
+#define BENCH_ROUNDS 10
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// times of the loads in ms, the UNDO image of the last load is returned
+static bool bench(const char*   pFileName,
+                  XmlParserType pParser,
+                  int           pRounds,
+                  double&       pBest,
+                  double&       pTotal,
+                  string&       pImage)
+{
+    DoLog* doLog = DoLog::getInstance();
+    logUndoXmlParser(pParser);
+
+    pBest = 0;
+    pTotal = 0;
+    for (int i = 0; i < pRounds; i++)
+    {
+        doLog->clean();
+        double start = now();
+        if (!doLog->load(pFileName))
+        {
+            return false;
+        }
+        double elapsed = now() - start;
+
+        pTotal += elapsed;
+        if (i == 0 || elapsed < pBest)
+        {
+            pBest = elapsed;
+        }
+    }
+
+    pImage = doLog->getXmlUndo();
+    doLog->clean();
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s <file> [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    int rounds = argc > 2 ? atoi(argv[2]) : BENCH_ROUNDS;
+    if (rounds < 1)
+    {
+        rounds = 1;
+    }
+
+    // Xerces first, so its initialization is not counted for the dedicated one
+    double xercesBest, xercesTotal, dedicatedBest, dedicatedTotal;
+    string xercesImage, dedicatedImage;
+    try
+    {
+        if (!bench(argv[1], XML_PARSER_XERCES, rounds, xercesBest, xercesTotal, xercesImage) ||
+            !bench(argv[1], XML_PARSER_DEDICATED, rounds, dedicatedBest, dedicatedTotal, dedicatedImage))
+        {
+            fprintf(stderr, "Unable load file: %s\n", argv[1]);
+            return 1;
+        }
+    }
+    catch (exception &e)
+    {
+        fprintf(stderr, "Exception caught while loading file: %s\n", e.what());
+        return 1;
+    }
+
+    printf("file: %s, rounds: %d\n", argv[1], rounds);
+    printf("xerces:    best %10.3f ms, average %10.3f ms\n", xercesBest, xercesTotal / rounds);
+    printf("dedicated: best %10.3f ms, average %10.3f ms\n", dedicatedBest, dedicatedTotal / rounds);
+    if (dedicatedBest > 0)
+    {
+        printf("speedup:   %.2f\n", xercesBest / dedicatedBest);
+    }
+
+    if (xercesImage != dedicatedImage)
+    {
+        fprintf(stderr, "UNDO images of the parsers differ\n");
+        return 1;
+    }
+
+    return 0;
+}
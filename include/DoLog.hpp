@@ -40,10 +40,18 @@
 #include <vector>
 #include <map>
 #include <list>
+#include <deque>
 #include <stdexcept>
 #include <sstream>
 
 #include <stdarg.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "DoLogXmlSink.hpp"
+#include "DoLogArena.hpp"
+#include "DoLogSymbol.hpp"
+#include "DoLogBinary.hpp"
 
 namespace dolog
 {
@@ -146,16 +154,21 @@ class Batch;
 // in XML stream.
 ///////////////////////////////////////////////////////////////////////////////
 
-typedef std::vector<SqlValue *>::iterator ColumnValueContainerIt;
-typedef std::vector<SqlValue *>::const_iterator ColumnValueContainerConstIt;
+typedef std::vector<SqlValue *, ArenaAllocator<SqlValue *> > ColumnValueContainer;
+typedef ColumnValueContainer::iterator ColumnValueContainerIt;
+typedef ColumnValueContainer::const_iterator ColumnValueContainerConstIt;
+
+// sets with more values are searched by label id using sorted index
+#define LABEL_INDEX_MIN_SIZE 8
 
-class ColumnValueSet
+class ColumnValueSet : public ArenaObject
 {
 public:
     ColumnValueSet();
     ~ColumnValueSet();
     void              clear();
-    std::string       getXml();
+    void              writeXml(XmlSink& pSink);
+    void              writeBinary(BinaryWriter& pWriter);
     void              addValue(SqlValue* pValue);
     std::string       getDigest();
     std::string       sqlColumnClause(std::string pSeparator);
@@ -166,17 +179,25 @@ public:
     std::string       findValueByLabel(const std::string& pLabel);
     bool              isEmpty();
     SqlValue*         findSqlValueByLabel(const std::string& pLabel);
+    SqlValue*         findSqlValueByLabel(Symbol pLabel);
     SqlValue*         sqlValue(std::string pTypeId,      // object factory
                                std::string pLabel,
                                std::string pValue);
+    SqlValue*         sqlValue(SqlValueType       pTypeId, // object factory
+                               Symbol             pLabel,
+                               const std::string& pValue);
     SqlValue*         sqlValue(HostVariableUse pUSeCase, // object factory
-                               char*           pLabel,
+                               Symbol          pLabel,
                                void*           pValueAny);
     ColumnValueSet&   operator+=(SqlValue* rhs);
     ColumnValueSet&   operator=(ColumnValueSet& rhs);
     ColumnValueSet&   operator+=(ColumnValueSet& rhs);
+    void              swap(ColumnValueSet& rhs);
+    void              reserve(size_t pCount);
+    void              steal(ColumnValueSet& rhs);
 private:
-    std::vector<SqlValue *> mValueContainer;
+    ColumnValueContainer mValueContainer;
+    ColumnValueContainer mLabelIndex; // sorted by label id, empty - not built
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -186,13 +207,14 @@ private:
 // values are stored in the super-class.
 ///////////////////////////////////////////////////////////////////////////////
 
-class Operation // purely virtual class
+class Operation : public ArenaObject // purely virtual class
 {
 public:
-    Operation(std::string pEntity);
+    Operation(Symbol pEntity);
     virtual ~Operation();
-    virtual std::string          getXmlRedo() = 0;
-    virtual std::string          getXmlUndo() = 0;
+    virtual void                 writeXmlRedo(XmlSink& pSink) = 0;
+    virtual void                 writeXmlUndo(XmlSink& pSink) = 0;
+    virtual void                 writeBinaryUndo(BinaryWriter& pWriter) = 0;
     void                         addKey(SqlValue* pValue);
     void                         addKeySet(ColumnValueSet* pValueSet);
     virtual void                 addValue(SqlValue* pValueSet,
@@ -201,13 +223,14 @@ public:
                                              ColumnValueSet*  pValueAfter) = 0;
     virtual std::string          sqlStatementText() = 0;
     ColumnValueSet*              getKeySet();
+    Symbol                       getEntity() { return mEntity; }
     virtual ColumnValueSet*      getValueSet() = 0;
     virtual bool                 isTypeEntityMatch(OperationType pType,
-                                                   std::string   pEntity) = 0;
+                                                   Symbol        pEntity) = 0;
     void                         setBatch(Batch* pBatch);
 protected:
     // key values must be avalable in sub-classes
-    std::string                  mEntity;  // on what entity
+    Symbol                       mEntity;  // on what entity
     Batch*                       mMyBatch; // it knows its batch (UPDATE - SELECT match)
     ColumnValueSet               mKey;     // by which key
 };
@@ -219,10 +242,11 @@ protected:
 class OperationInsert: public Operation
 {
 public:
-    OperationInsert(std::string pEntity);
+    OperationInsert(Symbol pEntity);
     virtual ~OperationInsert();
-    std::string          getXmlRedo();
-    std::string          getXmlUndo();
+    void                 writeXmlRedo(XmlSink& pSink);
+    void                 writeXmlUndo(XmlSink& pSink);
+    void                 writeBinaryUndo(BinaryWriter& pWriter);
     void                 addValue(SqlValue* pValue,
                                   OperationValueState pState);
     void                 addValueSet(ColumnValueSet*  pValueBefore,
@@ -230,7 +254,7 @@ public:
     ColumnValueSet*      getValueSet();
     std::string          sqlStatementText();
     bool                 isTypeEntityMatch(OperationType pType,
-                                           std::string   pEntity);
+                                           Symbol        pEntity);
 protected:
     ColumnValueSet       mValueAfter;
 };
@@ -242,10 +266,11 @@ protected:
 class OperationDelete : public Operation
 {
 public:
-    OperationDelete(std::string pEntity);
+    OperationDelete(Symbol pEntity);
     virtual ~OperationDelete();
-    std::string          getXmlRedo();
-    std::string          getXmlUndo();
+    void                 writeXmlRedo(XmlSink& pSink);
+    void                 writeXmlUndo(XmlSink& pSink);
+    void                 writeBinaryUndo(BinaryWriter& pWriter);
     void                 addValue(SqlValue* pValue,
                                   OperationValueState pState);
     void                 addValueSet(ColumnValueSet*  pValueBefore,
@@ -253,7 +278,7 @@ public:
     ColumnValueSet*      getValueSet();
     std::string          sqlStatementText();
     bool                 isTypeEntityMatch(OperationType pType,
-                                           std::string   pEntity);
+                                           Symbol        pEntity);
 protected:
     ColumnValueSet       mValueBefore;
 };
@@ -265,10 +290,11 @@ protected:
 class OperationUpdate : public Operation
 {
 public:
-    OperationUpdate(std::string pEntity);
+    OperationUpdate(Symbol pEntity);
     virtual ~OperationUpdate();
-    std::string          getXmlRedo();
-    std::string          getXmlUndo();
+    void                 writeXmlRedo(XmlSink& pSink);
+    void                 writeXmlUndo(XmlSink& pSink);
+    void                 writeBinaryUndo(BinaryWriter& pWriter);
     void                 addValue(SqlValue* pValue,
                                   OperationValueState pState);
     void                 addValueSet(ColumnValueSet*  pValueBefore,
@@ -276,8 +302,9 @@ public:
     ColumnValueSet*      getValueSet();
     std::string          sqlStatementText();
     bool                 isTypeEntityMatch(OperationType pType,
-                                           std::string   pEntity);
+                                           Symbol        pEntity);
 protected:
+    void                 resolveValueBefore();
     ColumnValueSet       mValueBefore;
     ColumnValueSet       mValueAfter;
 };
@@ -289,10 +316,11 @@ protected:
 class OperationSelect : public Operation
 {
 public:
-    OperationSelect(std::string pEntity);
+    OperationSelect(Symbol pEntity);
     virtual ~OperationSelect();
-    std::string          getXmlRedo();
-    std::string          getXmlUndo();
+    void                 writeXmlRedo(XmlSink& pSink);
+    void                 writeXmlUndo(XmlSink& pSink);
+    void                 writeBinaryUndo(BinaryWriter& pWriter);
     void                 addValue(SqlValue* pValue,
                                   OperationValueState pState);
     void                 addValueSet(ColumnValueSet*  pValueBefore,
@@ -300,7 +328,7 @@ public:
     ColumnValueSet*      getValueSet();
     std::string          sqlStatementText();
     bool                 isTypeEntityMatch(OperationType pType,
-                                           std::string   pEntity);
+                                           Symbol        pEntity);
 protected:
     ColumnValueSet       mValueBefore; // and After but no need to declare separately
 };
@@ -309,26 +337,91 @@ protected:
 // batch of db operations done in a sequential order, factory has access to data
 ///////////////////////////////////////////////////////////////////////////////
 
-typedef std::list<Operation*>::iterator OperationListIt;           // REDO order
-typedef std::list<Operation*>::reverse_iterator OperationListRevIt;// UNDO order
+typedef std::list<Operation*, ArenaAllocator<Operation*> > OperationList;
+typedef OperationList::iterator OperationListIt;           // REDO order
+typedef OperationList::reverse_iterator OperationListRevIt;// UNDO order
 
-class Batch
+// first operation of the batch by type and entity
+typedef std::pair<OperationType, SymbolId> OperationTypeEntity;
+typedef std::map<OperationTypeEntity,
+                 Operation*,
+                 std::less<OperationTypeEntity>,
+                 ArenaAllocator<std::pair<const OperationTypeEntity, Operation*> > > OperationIndex;
+typedef OperationIndex::iterator OperationIndexIt;
+
+class Batch : public ArenaObject
 {
     friend class DoLog;
 public:
-    Batch(std::string pDigest,
-          ColumnValueSet* pBatchKey);
+    Batch(ColumnValueSet* pBatchKey);
     ~Batch();
-    std::string           getXmlRedo();
-    std::string           getXmlUndo();
+    void                  writeXmlRedo(XmlSink& pSink);
+    void                  writeXmlUndo(XmlSink& pSink);
+    void                  writeBinaryUndo(BinaryWriter& pWriter);
     void                  sqlStatementTextAll(StringVector& pSqlTextContainer);
+    void                  addOperation(Operation*    pOperation,
+                                       OperationType pType,
+                                       Symbol        pEntity);
+    void                  append(Batch& rhs);       // operations taken over
     ColumnValueSet*       findFirstBatchOperation(OperationType pType,
-                                                  std::string   pEntity);
+                                                  Symbol        pEntity);
     ColumnValueSet*       getBatchKey();
+    const std::string&    getDigest();
+    bool                  hasUndo() { return mUndoCount > 0; }
 private:
-    std::string           mDigest;
+    std::string           mDigest;  // built upon first use from the key
     ColumnValueSet*       mBatchKey;
-    std::list<Operation*> mOperation;// the list keeps order of adding the operation
+    OperationList         mOperation;// the list keeps order of adding the operation
+    OperationIndex        mFirstOperation;// first operation on type & entity
+    size_t                mUndoCount;// operations other than SELECT
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Row descriptor: layout of host struct with columns of an entity registered
+// once, the row is captured by copying the values from the offsets of the
+// columns. The char sequences and varchars must be stored inside the struct.
+///////////////////////////////////////////////////////////////////////////////
+
+typedef struct RowColumn
+{
+    HostVariableUse section; // KEY or VALUE
+    HostVariableUse use;     // VAR_REF_...
+    const char*     label;
+    size_t          offset;  // of host variable in the struct, use offsetof
+
+} RowColumn;
+
+// column with label already interned
+typedef struct RowDescriptorColumn
+{
+    HostVariableUse use;
+    Symbol          label;
+    size_t          offset;
+
+} RowDescriptorColumn;
+
+typedef std::vector<RowDescriptorColumn> RowDescriptorColumnContainer;
+
+class RowDescriptor
+{
+public:
+    RowDescriptor(Symbol           pEntity,
+                  const RowColumn* pColumn,
+                  int              pColumnCount);
+    Symbol                        getEntity();
+    size_t                        getRowExtent() { return mRowExtent; }
+    void                          getKeySet(const void*     pRow,
+                                            ColumnValueSet& pKeySet);
+    void                          getValueSet(const void*     pRow,
+                                              ColumnValueSet& pValueSet);
+private:
+    void                          getColumnValueSet(RowDescriptorColumnContainer& pColumn,
+                                                    const void*                   pRow,
+                                                    ColumnValueSet&               pValueSet);
+    Symbol                        mEntity;
+    RowDescriptorColumnContainer  mKey;
+    RowDescriptorColumnContainer  mValue;
+    size_t                        mRowExtent;// end of the last column
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -346,10 +439,217 @@ private:
 // 4. SELECT, UPDATE -> UPDATE
 ///////////////////////////////////////////////////////////////////////////////
 
-typedef std::map<std::string, Batch*> BatchContainer;
-typedef std::map<std::string, Batch*>::iterator BatchContainerIt;
+typedef std::vector<Batch*> BatchContainer;     // in order of registration
+typedef BatchContainer::iterator BatchContainerIt;
+typedef std::map<std::string, Batch*> BatchDigestIndex;
+typedef BatchDigestIndex::iterator BatchDigestIndexIt;
+
+// initial number of slots of batch index, always power of 2
+#define BATCH_INDEX_INIT_SIZE 1024
+
+//
+// Open addressing hash table of batches registered with logUndoBatch indexed
+// by customer id and bill seq no. The slots are kept upon clear so no memory
+// is allocated in the steady state.
+//
+
+struct BatchIndexSlot
+{
+    int    customerId;
+    int    billSeqNo;
+    Batch* batch;     // NULL - empty slot
+};
+
+class BatchIndex
+{
+public:
+    BatchIndex();
+    Batch*                      find(int pCustomerId,
+                                     int pBillSeqNo);
+    void                        insert(int    pCustomerId,
+                                       int    pBillSeqNo,
+                                       Batch* pBatch);
+    void                        clear();
+private:
+    size_t                      slotOf(int pCustomerId,
+                                       int pBillSeqNo);
+    void                        grow();
+    std::vector<BatchIndexSlot> mSlot;
+    size_t                      mCount;
+};
+
+//
+// Batches of a context shared by many threads split into shards by hash of
+// customer id and bill seq no. Each shard is locked separately so the threads
+// capturing different customers do not wait one for another. The batches of all
+// shards are collected at once upon flush.
+//
+
+struct BatchShard
+{
+    pthread_mutex_t mutex;
+    BatchIndex      index;
+    BatchContainer  batch;   // in order of registration in the shard
+};
+
+class BatchStore
+{
+public:
+    BatchStore(size_t pShardCount);
+    ~BatchStore();
+    BatchShard*              shardOf(int pCustomerId,
+                                     int pBillSeqNo);
+    void                     collect(BatchContainer& pBatchContainer);
+    unsigned int             getGeneration();
+    pthread_mutex_t*         getFlushMutex();
+private:
+    BatchStore(const BatchStore&);
+    std::vector<BatchShard*> mShard;
+    unsigned int             mGeneration; // number of collects done
+    pthread_mutex_t          mFlushMutex; // one flush at a time
+};
+
+// mutex locked until the end of the scope, NULL - nothing to lock
+class MutexLock
+{
+public:
+    MutexLock(pthread_mutex_t* pMutex) : mMutex(pMutex) { if (mMutex) pthread_mutex_lock(mMutex); }
+    ~MutexLock() { if (mMutex) pthread_mutex_unlock(mMutex); }
+private:
+    pthread_mutex_t* mMutex;
+};
+
+class DoLog;
+
+//
+// Batches spilled out of memory: the images of each batch key, the batch
+// itself stays with its key and SELECT values for the operations to come
+//
+
+struct SpillSegment
+{
+    long   offset;  // of the image in the spill file
+    size_t length;
+};
+
+typedef std::vector<SpillSegment> SpillSegmentContainer;    // in order of spill
+typedef std::map<std::string, SpillSegmentContainer> SpillIndex;// by digest
+
+//
+// Second buffer of a context: the batches handed over upon asynchronous flush
+// together with the arena holding them. They are saved and committed by
+// the writer thread while the context captures the next transaction.
+//
+
+class FlushHandle
+{
+    friend class DoLog;
+public:
+    bool                 wait();       // true - the batches were saved
+private:
+    FlushHandle();
+    FlushHandle(const FlushHandle&);
+    static void*         start(void* pHandle);
+    void                 collectStatistics();
+    DoLog*               mLog;
+    DoLog*               mWriter;      // own image, arrays and sequence block
+    BatchContainer       mBatchContainer;
+    Arena                mArena;
+    FILE*                mSpillFile;
+    SpillIndex           mSpillIndex;
+    pthread_t            mThread;
+    bool                 mIsPending;   // writer thread not joined yet
+    bool                 mIsSaved;
+};
+
+//
+// Consumer of the batches streamed by load: it is called for each batch as soon
+// as the batch is parsed, the batch is released upon return
+//
+typedef void (*BatchCallback)(Batch* pBatch,
+                              void*  pUserData);
+
+//
+// Parser of XML records upon load: the dedicated one reads only the subset
+// of XML written by the library and leaves any other document to Xerces
+//
+enum XmlParserType
+{
+    XML_PARSER_XERCES = 0,
+    XML_PARSER_DEDICATED = 1
+};
+
+//
+// Record of UNDO_TRANSACTION_LOG fetched upon load and parsed by a parser
+// thread into its own batches
+//
 
-class DoLog // Singleton class
+struct LoadJob
+{
+    int                  seqNo;
+    unsigned char*       buffer;       // LONG VARCHAR host variable
+    int                  bufferLength; // of the image it may hold
+    const unsigned char* image;        // in the buffer
+    size_t               imageLength;
+    bool                 isDone;       // parsed
+    std::string          errmsg;       // empty - parsed correctly
+    BatchContainer       batch;        // parsed from the record
+};
+
+//
+// Parser threads of a load: the records are fetched by the loading thread
+// and parsed concurrently, each thread with own context and parser. The
+// records are taken back in order of fetch and their batches are merged
+// into the loading context, the same as if they were parsed one by one.
+//
+
+class LoadPipeline
+{
+public:
+    LoadPipeline(DoLog* pLog,
+                 int    pWorkerCount);
+    ~LoadPipeline();
+    size_t                getWorkerCount();
+    bool                  isFull();                 // no free job
+    LoadJob*              getFreeJob();
+    void                  submit(LoadJob* pJob);
+    LoadJob*              nextDone(bool pWait);     // NULL - none done
+    void                  release(LoadJob* pJob);
+private:
+    LoadPipeline(const LoadPipeline&);
+    static void*          start(void* pPipeline);
+    void                  run();
+    DoLog*                mLog;
+    std::vector<DoLog*>   mWorker;        // context of each parser thread
+    std::vector<pthread_t> mThread;
+    std::vector<LoadJob*> mJob;
+    std::vector<LoadJob*> mFreeJob;
+    std::deque<LoadJob*>  mInFlight;      // in order of fetch
+    std::deque<LoadJob*>  mQueue;         // to be parsed
+    pthread_mutex_t       mMutex;
+    pthread_cond_t        mWork;          // job queued or stop
+    pthread_cond_t        mDone;          // job parsed
+    size_t                mStarted;       // threads which took their context
+    bool                  mIsStopped;
+};
+
+// host arrays of the array INSERT, defined in DB access module
+struct DbInsertArray;
+
+// maximal number of row descriptors registered in the process
+#define MAX_ROW_DESCRIPTOR 256
+
+//
+// Capture context: each thread registers its operations in its own instance
+// so that the capture needs no lock; only the first use of a name in the
+// process interns it under the lock of the symbol table, the known names are
+// looked up without it. The instance is created upon first use
+// in the thread and released at thread exit unless it was bound explicitly.
+// A context with batch store may be bound to many threads at once, then
+// each thread has its own current batch.
+//
+
+class DoLog
 {
     friend void logUndoInit(const char* pDbName,
                             const char* pDbUser,
@@ -358,42 +658,183 @@ class DoLog // Singleton class
                             const int   pLogLevel);
     friend void logUndoBatch(int pCustomerId,
                              int pBillSeqNo);
+    friend void logUndoValueSets(const OperationType pOperationType,
+                                 Symbol              pEntity,
+                                 ColumnValueSet&     pKeySet,
+                                 ColumnValueSet*     pValueBefore,
+                                 ColumnValueSet*     pValueAfter);
+    friend void logUndoRows(const OperationType pOperationType,
+                            const int           pRowDescriptorId,
+                            const void*         pRows,
+                            const size_t        pRowSize,
+                            const int           pRowCount);
     friend void logUndoFlush();
+    friend void logUndoInsertArraySize(const int pArraySize);
+    friend DoLog* logUndoContextCreate(const int pShardCount);
+    friend class CurrentBatchLock;
+    friend class FlushHandle;
+    friend FlushHandle* logUndoFlushAsync();
+    friend void logUndoMemoryBudget(const size_t pBytes);
+    friend void logUndoFormat(const UndologFormat pFormat);
+    friend void logUndoXmlParser(const XmlParserType pParser);
+    friend void logUndoDbContext(void* pSqlContext);
+    friend void logUndoLoadWorkers(const int pWorkerCount);
+    friend class LoadPipeline;
 public:
     ~DoLog();
-    static DoLog*        getInstance();
+    static DoLog*        getInstance();                 // context of the thread
+    static DoLog*        findInstance();                // the same, NULL if none yet
+    static DoLog*        setInstance(DoLog* pContext);  // returns previous one
     void                 clean();
     std::string          getXmlRedo();
     std::string          getXmlUndo();
+    void                 writeXmlRedo(XmlSink& pSink);
+    void                 writeXmlUndo(XmlSink& pSink);
+    void                 writeUndo(XmlSink& pSink);             // in format set
     bool                 save(const char* pFileName);
     bool                 load(const char* pFileName);
     bool                 save();                                // using DB
+    FlushHandle*         saveAsync();                           // using DB in writer thread
     bool                 load(const int pBillSeqNo = 0,         // using DB
                               const int pCustomerId = 0);
     Operation*           sqlOperation(ColumnValueSet* pValueSet,// object factory
                                       OperationType   pType,
-                                      std::string     pEntity);
+                                      Symbol          pEntity,
+                                      bool*           pIsKeyTaken = NULL);
+    Operation*           sqlOperation(Batch*          pBatch,   // object factory
+                                      OperationType   pType,
+                                      Symbol          pEntity);
+    void                 setBatchCallback(BatchCallback pCallback,    // NULL - batches kept
+                                          void*         pUserData = NULL);
+    void                 batchLoaded(ColumnValueSet* pBatchKey);    // end of batch parsed
+    int                  getSeqNoRoundTripsSaved();
+    size_t               getImageHighWaterMark();
+    size_t               getArenaHighWaterMark();
     void                 sqlStatementTextAll(std::vector<std::string>& pSqlStatementContainer);
     bool                 sqlStatementApply(const std::string &pSqlStatement);
     bool                 sqlStatementApplyAll(std::vector<std::string>& pSqlStatementContainer);
 protected:
-    bool                 dbLongVarcharInsert(std::string& pImage,
-                                             std::string& pDigest,
-                                             std::string& pCustomerId,
-                                             std::string& pBillSeqNo);
+    bool                 dbConnect(const char* pDbName,
+                                   const char* pDbUser,
+                                   const char* pDbPass);
+    bool                 dbCommit();
+    void                 dbRelease();
+    bool                 dbLongVarcharInsert(XmlMemorySink&     pImage,
+                                             const std::string& pDigest,
+                                             std::string&       pCustomerId,
+                                             std::string&       pBillSeqNo);
+    char*                dbLongVarcharInsertArraySlot();
+    bool                 dbLongVarcharInsertArrayAdd(size_t             pImageLength,
+                                                     const std::string& pDigest,
+                                                     std::string&       pCustomerId,
+                                                     std::string&       pBillSeqNo);
+    bool                 dbLongVarcharInsertArrayFlush();
+    void                 dbInsertArrayRelease();
+    bool                 dbUndoTransLogIdNext(long& pSeqNo);
     bool                 dbLongVarcharSelect(int pSeqNo,
                                              int pImageLength);
+    bool                 dbLongVarcharSelect(LoadPipeline& pPipeline,
+                                             int           pSeqNo,
+                                             int           pImageLength);
+    bool                 dbLongVarcharSelectWait(LoadPipeline& pPipeline);
+    bool                 dbLongVarcharFetch(int             pSeqNo,
+                                            int             pImageLength,
+                                            unsigned char*& pBuffer,
+                                            int&            pBufferLength);
+    bool                 dbLoadStatusUpdate(int                pSeqNo,
+                                            const std::string& pErrmsg);
+    bool                 dbLoadRecord(LoadPipeline* pPipeline,
+                                      int           pSeqNo,
+                                      int           pImageLength);
+    bool                 dbLoadCursor(const int     pBillSeqNo,
+                                      const int     pCustomerId,
+                                      LoadPipeline* pPipeline);
+    bool                 dbLoadCursorDefault(const int     pBillSeqNo,
+                                             const int     pCustomerId,
+                                             LoadPipeline* pPipeline);
+    std::string          parseRecord(const unsigned char* pBuffer,   // error message, empty - parsed
+                                     const size_t         pBufferLength);
+    void                 mergeBatches(BatchContainer& pBatchContainer);
     void                 xmlParse(const unsigned char* pXmlString,// using XALAN engine
                                   const size_t         pXmlStringLength);
-    ColumnValueSet*      findBatchKey(std::string& pSearchDigest);
-    Batch*               addBatch(std::string&    pSearchDigest,
-                                  ColumnValueSet* pKey);
+    bool                 xmlDedicatedParse(const unsigned char* pXmlString, // false - not parsed
+                                           const size_t         pXmlStringLength);
+    void                 binaryParse(const unsigned char* pBuffer,
+                                     const size_t         pBufferLength);
+    void                 parse(const unsigned char* pBuffer,   // any format
+                               const size_t         pBufferLength);
+    void                 writeUndoHead(XmlSink& pSink);
+    void                 writeUndoBatch(Batch*   pBatch,
+                                        XmlSink& pSink);
+    void                 writeUndoTail(XmlSink& pSink);
+    void                 writeUndoBatch(Batch*      pBatch,
+                                        XmlSink&    pSink,
+                                        FILE*       pSpillFile,
+                                        SpillIndex& pSpillIndex);
+    void                 writeUndoRecord(Batch*      pBatch,
+                                         XmlSink&    pSink,
+                                         FILE*       pSpillFile,
+                                         SpillIndex& pSpillIndex);
+    Batch*               findBatch(int pCustomerId,
+                                   int pBillSeqNo);
+    Batch*               addBatch(int pCustomerId,
+                                  int pBillSeqNo);
+    Batch*               findBatch(ColumnValueSet* pKey);
+    Batch*               addBatch(ColumnValueSet* pKey);
+    void                 useSharedBatch(int pCustomerId,
+                                        int pBillSeqNo);
+    Batch*               findSharedBatch(BatchShard* pShard,
+                                         int         pCustomerId,
+                                         int         pBillSeqNo);
+    Batch*               lockCurrentBatch();
+    void                 unlockCurrentBatch();
+    bool                 save(BatchContainer& pBatchContainer,
+                              FILE*           pSpillFile,
+                              SpillIndex&     pSpillIndex);
+    bool                 isOverBudget();
+    bool                 spill();
+    Batch*               retainBatch(Batch* pBatch);
+    void                 releaseBatches(BatchContainer& pBatchContainer,
+                                        Arena&          pArena);
+    void                 commit();
 private:
-    static DoLog*        sInstance;
+    static __thread DoLog* sInstance;      // context bound to the thread
+    bool                 mIsThreadOwned;   // released at thread exit
     bool                 mHandleDbConnect;
     char*                mDbHandle;
+    void*                mSqlContext;      // Pro*C runtime context of the connection, NULL - default
+    bool                 mIsSqlContextOwned;// allocated for own connection
     std::string          mDbUserName;
     BatchContainer       mBatchContainer;
+    BatchIndex           mBatchIndex;      // batches of logUndoBatch
+    BatchDigestIndex     mBatchDigestIndex;// batches with any key (loaded)
+    ColumnValueSet*      mLastBatchKey;    // last key resolved by digest
+    Batch*               mLastBatch;
+    Batch*               mCurrentBatch;    // set by logUndoBatch
+    BatchStore*          mBatchStore;      // NULL - context of one thread
+    int                  mInsertArraySize; // rows per array INSERT, 1 - no array
+    DbInsertArray*       mInsertArray;
+    std::vector<long>    mSeqNoBlock;      // UNDO_TRANS_LOG_ID values reserved
+    size_t               mSeqNoNext;       // next value to be used from the block
+    int                  mSeqNoFetchCount; // sequence round trips in current flush
+    int                  mSeqNoKeyCount;   // keys assigned in current flush
+    XmlMemorySink        mImage;           // LONG VARCHAR host variable
+    size_t               mImageHighWaterMark; // biggest image rendered
+    unsigned char*       mSelectBuffer;    // LONG VARCHAR of loaded image
+    int                  mSelectBufferLength;
+    Arena                mArena;           // batches with all their content
+    size_t               mArenaHighWaterMark; // max arena memory used in a flush
+    FlushHandle          mFlush;           // batches being saved asynchronously
+    size_t               mMemoryBudget;    // arena bytes kept in memory, 0 - no limit
+    FILE*                mSpillFile;       // batches rendered out of memory
+    SpillIndex           mSpillIndex;      // their parts in the file by digest
+    XmlMemorySink        mSpillImage;
+    int                  mSpillCount;      // batches spilled since last flush
+    UndologFormat        mFormat;          // of the records saved
+    BatchCallback        mBatchCallback;   // consumer of loaded batches, NULL - kept
+    void*                mBatchCallbackData;
+    XmlParserType        mXmlParser;       // of the XML records loaded
+    int                  mLoadWorkerCount; // parser threads of load, 1 - none
     DoLog();
     DoLog(const DoLog&);
 };
@@ -412,6 +853,39 @@ void logUndoInit(const char* pDbName,
                  const char* pDbConnectionId,
                  const int   pLogLevel = 0);
 
+//
+// Set the Pro*C runtime context (sql_context) in which the caller opened the
+// connection used when pDbName was NULL. Without it the connection is used in
+// the default runtime context, as done by a single threaded caller; only the
+// callers using connections from many threads need to set it. The library is
+// precompiled with THREADS=YES, the context must not be used by the caller
+// while the DoLog context accesses the DB. The connection opened by
+// logUndoInit uses its own runtime context.
+//
+void logUndoDbContext(void* pSqlContext);
+
+//
+// Create a capture context not bound to any thread. All interface functions
+// work on the context bound to the calling thread, by default one is created
+// for each thread upon first use. Each context is initialized, flushed and
+// committed independently with its own connection id. With pShardCount > 0
+// the context may be bound to many threads, its batches are kept in a store
+// with the given number of shards; flush saves the batches of all threads,
+// after it each thread captures into a new batch of its last logUndoBatch key.
+//
+DoLog* logUndoContextCreate(const int pShardCount = 0);
+
+//
+// Bind the context to the calling thread returning the previously bound one,
+// the caller becomes owner of the returned context
+//
+DoLog* logUndoContextBind(DoLog* pContext);
+
+//
+// Release the context, it must not be bound to any thread
+//
+void logUndoContextDestroy(DoLog* pContext);
+
 //
 // Init for next cache record setting the cursor for all subsequent operations
 // to a specific pair of <CUSTOMER_ID, BILLSEQNO>
@@ -421,18 +895,119 @@ void logUndoBatch(int pCustomerId,
 
 //
 // Log UNDO operation for entity of specified type assigning it to the previously
-// initialized batch
+// initialized batch. The arguments are checked at run time, the template
+// interface of DoLogCapture.hpp checks them at compile time.
 //
 void logUndo(const OperationType pOperationType,
              const char*         pEntity,
              ...);
 
+//
+// Register operation with the value sets already built, the values are taken
+// over by the operation. It is used by the type safe template interface
+// declared in DoLogCapture.hpp.
+//
+void logUndoValueSets(const OperationType pOperationType,
+                      Symbol              pEntity,
+                      ColumnValueSet&     pKeySet,
+                      ColumnValueSet*     pValueBefore,
+                      ColumnValueSet*     pValueAfter);
+
+//
+// Register the layout of host struct used for capture of an entity, returns
+// id of the row descriptor to be used with logUndoRow
+//
+int logUndoRowDescriptor(const char*      pEntity,
+                         const RowColumn* pColumn,
+                         const int        pColumnCount);
+
+//
+// Log UNDO operation for entity of the row descriptor with the values
+// in the host struct. The second form with the values before and after
+// is allowed only for UPDATE.
+//
+void logUndoRow(const OperationType pOperationType,
+                const int           pRowDescriptorId,
+                const void*         pRow);
+
+void logUndoRow(const OperationType pOperationType,
+                const int           pRowDescriptorId,
+                const void*         pRowBefore,
+                const void*         pRowAfter);
+
+//
+// Log UNDO operations for entity of the row descriptor, one operation for
+// each row of the host array of structs, pRowSize is the size of the struct
+// (array stride). It is the same as logUndoRow called for each row.
+//
+void logUndoRows(const OperationType pOperationType,
+                 const int           pRowDescriptorId,
+                 const void*         pRows,
+                 const size_t        pRowSize,
+                 const int           pRowCount);
+
+//
+// Set the number of XML records inserted with one array INSERT upon flush,
+// the value 1 switches the array mode off
+//
+void logUndoInsertArraySize(const int pArraySize);
+
+//
+// Set memory budget of the context, 0 - no limit. When the memory used by
+// the batches exceeds the budget upon next logUndoBatch, all the batches
+// registered so far are rendered into a temporary file and released, only
+// their keys and SELECT values stay in memory. They are read back upon flush,
+// the batch revisited after being spilled is saved as one record with its
+// spilled operations.
+//
+void logUndoMemoryBudget(const size_t pBytes);
+
+//
+// Set format of the records saved by the context, XML by default. The records
+// of both formats are recognized upon load. The format may be changed only
+// when no batches are registered.
+//
+void logUndoFormat(const UndologFormat pFormat);
+
+//
+// Set parser of the XML records loaded by the context, Xerces by default.
+// The dedicated parser falls back to Xerces for the documents using XML
+// constructs not written by the library.
+//
+void logUndoXmlParser(const XmlParserType pParser);
+
+//
+// Set the number of parser threads used by load from DB, limited to
+// MAX_LOAD_WORKER_COUNT. The records are fetched by the calling thread and
+// parsed concurrently, the value 1 switches the threads off. The threads
+// are not used if batch callback is set.
+//
+void logUndoLoadWorkers(const int pWorkerCount);
+
 //
 // Flush all batches for a current cache doing commit if initialize with specific
 // DB connection
 //
 void logUndoFlush();
 
+//
+// Flush all batches for a current cache in background: the batches are handed
+// over to the writer thread saving them and doing commit if initialized with
+// specific DB connection. The capture of the next transaction may start at once,
+// the handle must be waited for before the commit point of the caller.
+// Only one flush of the context is in progress, the next one waits for it.
+// The writer thread uses the connection of the context, so only the connection
+// opened by logUndoInit is used in background; the DB methods of the context
+// wait for the flush. With connection of the caller the batches are saved
+// at once by the calling thread.
+//
+FlushHandle* logUndoFlushAsync();
+
+//
+// Wait until the asynchronous flush is done, false - the batches were not saved
+//
+bool logUndoFlushWait(FlushHandle* pHandle);
+
 }
 
 #endif
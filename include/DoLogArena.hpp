@@ -0,0 +1,168 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogArena.hpp
+// Description: Provides monotonic memory arena used for all the objects of
+//              the log living between logUndoBatch and logUndoFlush: values,
+//              value sets, operations and batches. The objects are never
+//              released one by one, the whole arena is rewound upon flush.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-09
+// Abstract   : Provides monotonic memory arena.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#ifndef DoLogArena_hpp
+#define DoLogArena_hpp
+
+#include <cstddef>
+#include <new>
+
+namespace dolog
+{
+
+// size of the memory chunk allocated by the arena from the heap
+#define ARENA_CHUNK_SIZE  (1024 * 1024)
+
+// number of chunks kept for reuse upon rewind, the rest is released
+#define ARENA_KEEP_CHUNKS 16
+
+///////////////////////////////////////////////////////////////////////////////
+// Arena: monotonic buffer made of chunks, memory is only released as a whole
+///////////////////////////////////////////////////////////////////////////////
+
+struct ArenaChunk;
+
+class Arena
+{
+public:
+    Arena(size_t pChunkSize = ARENA_CHUNK_SIZE);
+    ~Arena();
+    void*          allocate(size_t pSize);
+    void           reset();
+    void           swap(Arena& rhs);
+    void           adopt(Arena& rhs);
+    size_t         getBytesUsed();
+    size_t         getBytesReserved();
+    static Arena*  getCurrent();
+    static void    setCurrent(Arena* pArena);
+private:
+    Arena(const Arena&);
+    Arena&         operator=(const Arena&);
+    ArenaChunk*    addChunk(size_t pSize);
+    ArenaChunk*    mFirst;     // chunk list in order of allocation
+    ArenaChunk*    mCurrent;   // chunk used for next allocation
+    size_t         mChunkSize;
+    size_t         mBytesUsed;
+    static __thread Arena* sCurrent; // arena of the thread used by arena objects and allocators
+};
+
+//
+// Allocation from the current arena. The block has a header telling where
+// it comes from so it may be released correctly: the heap is used if there is
+// no current arena, the release of arena block is a no-op.
+//
+void* arenaAllocate(size_t pSize);
+void  arenaRelease(void* pBlock);
+
+///////////////////////////////////////////////////////////////////////////////
+// ArenaObject: base class for the objects allocated with new in current arena
+///////////////////////////////////////////////////////////////////////////////
+
+class ArenaObject
+{
+public:
+    static void* operator new(size_t pSize);
+    static void  operator delete(void* pObject);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// ArenaAllocator: STL allocator using the current arena, used for containers
+// of the arena objects
+///////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T              value_type;
+    typedef T*             pointer;
+    typedef const T*       const_pointer;
+    typedef T&             reference;
+    typedef const T&       const_reference;
+    typedef size_t         size_type;
+    typedef ptrdiff_t      difference_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    ArenaAllocator() {}
+    ArenaAllocator(const ArenaAllocator&) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>&) {}
+
+    pointer       address(reference pValue) const { return &pValue; }
+    const_pointer address(const_reference pValue) const { return &pValue; }
+    size_type     max_size() const { return size_t(-1) / sizeof(T); }
+
+    pointer allocate(size_type pCount, const void* = 0)
+    {
+        return static_cast<pointer>(arenaAllocate(pCount * sizeof(T)));
+    }
+
+    void deallocate(pointer pBlock, size_type)
+    {
+        arenaRelease(pBlock);
+    }
+
+    void construct(pointer pBlock, const T& pValue)
+    {
+        new(static_cast<void*>(pBlock)) T(pValue);
+    }
+
+    void destroy(pointer pBlock)
+    {
+        pBlock->~T();
+    }
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&)
+{
+    return false;
+}
+
+}
+
+#endif
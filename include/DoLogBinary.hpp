@@ -0,0 +1,142 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogBinary.hpp
+// Description: Compact binary encoding of UNDOLOG records: batches, operations
+//              and typed values with native numbers, length prefixed strings
+//              and column labels written once per batch.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-23
+// Abstract   : Binary encoding of UNDOLOG records.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#ifndef DoLogBinary_hpp
+#define DoLogBinary_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "DoLogXmlSink.hpp"
+#include "DoLogSymbol.hpp"
+
+namespace dolog
+{
+
+//
+// Format of the UNDOLOG record written by save
+//
+typedef enum UndologFormat
+{
+    UNDOLOG_FORMAT_XML    = 0,
+    UNDOLOG_FORMAT_BINARY = 1
+
+} UndologFormat;
+
+//
+// Layout of the binary record, all numbers are little endian:
+//
+// record    := magic version batch* END
+// batch     := BATCH valueset operation* BATCH_END       (key of the batch)
+// operation := OPERATION type symbol valueset valueset    (entity, key, value)
+// valueset  := count value*
+// value     := typeid storage symbol count (string string)* payload
+// symbol    := 0 string | index + 1                       (index in the batch)
+// string    := length byte*
+// payload   := signed | float | double | string           (by storage)
+//
+// The unsigned numbers are written in 7 bit groups, the signed ones are
+// zig-zag encoded first. The XML record starts always with '<' so the magic
+// tells the format of the record read.
+//
+
+#define BINARY_MAGIC         "\177DLB"
+#define BINARY_MAGIC_LEN     4
+#define BINARY_VERSION       1
+
+#define BINARY_TAG_BATCH     'B'
+#define BINARY_TAG_OPERATION 'O'
+#define BINARY_TAG_BATCH_END 'E'
+#define BINARY_TAG_END       'Z'
+
+bool isBinaryUndolog(const unsigned char* pData,
+                     size_t               pLength);
+
+///////////////////////////////////////////////////////////////////////////////
+// BinaryWriter: encoding of the elements into the sink
+///////////////////////////////////////////////////////////////////////////////
+
+class BinaryWriter
+{
+public:
+    BinaryWriter(XmlSink& pSink);
+    void                 writeHead();
+    void                 writeTail();
+    void                 beginBatch();     // symbols are written again
+    void                 writeByte(unsigned char pValue);
+    void                 writeUnsigned(unsigned long pValue);
+    void                 writeSigned(long pValue);
+    void                 writeFloat(float pValue);
+    void                 writeDouble(double pValue);
+    void                 writeString(const char* pData,
+                                     size_t      pLength);
+    void                 writeString(const std::string& pValue);
+    void                 writeSymbol(Symbol pSymbol);
+private:
+    XmlSink&             mSink;
+    std::map<SymbolId, unsigned long> mSymbolIndex;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// BinaryReader: decoding of the elements from memory, std::runtime_error
+// is thrown upon malformed or truncated record
+///////////////////////////////////////////////////////////////////////////////
+
+class BinaryReader
+{
+public:
+    BinaryReader(const unsigned char* pData,
+                 size_t               pLength);
+    void                 readHead();
+    void                 beginBatch();
+    unsigned char        readByte();
+    unsigned long        readUnsigned();
+    long                 readSigned();
+    float                readFloat();
+    double               readDouble();
+    std::string          readString();
+    Symbol               readSymbol();
+private:
+    void                 need(size_t pLength);
+    const unsigned char* mData;
+    size_t               mLength;
+    size_t               mPosition;
+    std::vector<Symbol>  mSymbol;
+};
+
+}
+
+#endif
@@ -0,0 +1,331 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogCapture.hpp
+// Description: Provides type safe template interface of UNDO log capture.
+//              The host variable types are mapped to SQL value types and
+//              the KEY/VALUE sections required by the operation type are
+//              checked by the compiler, no argument is decoded at run time.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-13
+// Abstract   : Provides type safe template interface of UNDO log capture.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#ifndef DoLogCapture_hpp
+#define DoLogCapture_hpp
+
+#include <stddef.h>
+
+#include "DoLogSqlValue.hpp"
+#include "DoLog.hpp"
+
+namespace dolog
+{
+
+//
+// Example (the same operation as in the example of HostVariableUse):
+//       logUndo<INSERT>("ENTITY_NAME",
+//                       key(column("CUSTOMER_ID", ival)),
+//                       value(dateColumn("BCH_RUN_DATE", cval))
+//                            (column("CONTRACT_NUM",     ival))
+//                            (column("BILLING_DURATION", dval))
+//                            (column("BILLING_ECHO",     sval))
+//                            (column("LONGVALUE",        lval)));
+//
+// UPDATE accepts also two VALUE sections: values before and after.
+//
+
+///////////////////////////////////////////////////////////////////////////////
+// SqlHostType: mapping of host variable type to the SQL value, the types
+// not listed are rejected by the compiler
+///////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+struct SqlHostType;
+
+template <>
+struct SqlHostType<int>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const int& pValue)
+    {
+        return new SqlInteger(pLabel, pValue);
+    }
+};
+
+template <>
+struct SqlHostType<short>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const short& pValue)
+    {
+        return new SqlSmallint(pLabel, pValue);
+    }
+};
+
+template <>
+struct SqlHostType<float>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const float& pValue)
+    {
+        return new SqlFloat(pLabel, pValue);
+    }
+};
+
+template <>
+struct SqlHostType<double>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const double& pValue)
+    {
+        return new SqlDouble(pLabel, pValue);
+    }
+};
+
+template <>
+struct SqlHostType<long>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const long& pValue)
+    {
+        return new SqlLong(pLabel, pValue);
+    }
+};
+
+// 0 terminated char sequence
+template <>
+struct SqlHostType<const char*>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const char* const& pValue)
+    {
+        return new SqlChar(pLabel, const_cast<char *>(pValue));
+    }
+};
+
+template <>
+struct SqlHostType<char*>
+{
+    static SqlValue* sqlValue(Symbol pLabel, char* const& pValue)
+    {
+        return new SqlChar(pLabel, pValue);
+    }
+};
+
+// 0 terminated char sequence with date, see dateColumn
+struct SqlDateHost
+{
+    const char* value;
+};
+
+template <>
+struct SqlHostType<SqlDateHost>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const SqlDateHost& pValue)
+    {
+        return new SqlDate(pLabel, (void *)pValue.value);
+    }
+};
+
+// Oracle varchar struct (len, arr), see varcharColumn
+struct SqlVarcharHost
+{
+    const void* value;
+};
+
+template <>
+struct SqlHostType<SqlVarcharHost>
+{
+    static SqlValue* sqlValue(Symbol pLabel, const SqlVarcharHost& pValue)
+    {
+        return new SqlVarchar(pLabel, const_cast<void *>(pValue.value));
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Column: labelled host variable, the numbers are kept by value, the char
+// sequences by pointer, the value is read when it is added to the section
+///////////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class Column
+{
+public:
+    Column(const char* pLabel,
+           T           pValue) : mLabel(pLabel), mValue(pValue) {}
+    SqlValue*   sqlValue() const
+    {
+        return SqlHostType<T>::sqlValue(Symbol(mLabel), mValue);
+    }
+private:
+    const char* mLabel;
+    T           mValue;
+};
+
+template <class T>
+Column<T> column(const char* pLabel,
+                 const T&    pValue)
+{
+    return Column<T>(pLabel, pValue);
+}
+
+// char array decays to 0 terminated char sequence
+template <size_t N>
+Column<const char*> column(const char* pLabel,
+                           const char  (&pValue)[N])
+{
+    return Column<const char*>(pLabel, pValue);
+}
+
+inline Column<SqlDateHost> dateColumn(const char* pLabel,
+                                      const char* pValue)
+{
+    SqlDateHost host = { pValue };
+    return Column<SqlDateHost>(pLabel, host);
+}
+
+// pointer to Oracle VARCHAR host variable, its struct is generated by
+// precompiler without name so it can not be template argument
+inline Column<SqlVarcharHost> varcharColumn(const char* pLabel,
+                                            const void* pValue)
+{
+    SqlVarcharHost host = { pValue };
+    return Column<SqlVarcharHost>(pLabel, host);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CaptureSection: values of KEY or VALUE section built from the columns,
+// a copy of the section takes over the values (as the section is returned
+// by value from key and value functions)
+///////////////////////////////////////////////////////////////////////////////
+
+template <HostVariableUse S>
+class CaptureSection
+{
+public:
+    CaptureSection() {}
+    CaptureSection(const CaptureSection& rhs)
+    {
+        mValueSet.steal(rhs.mValueSet);
+    }
+    template <class T>
+    CaptureSection& operator()(const Column<T>& pColumn)
+    {
+        mValueSet.addValue(pColumn.sqlValue());
+        return *this;
+    }
+    ColumnValueSet& getValueSet() const
+    {
+        return mValueSet;
+    }
+private:
+    CaptureSection& operator=(const CaptureSection&);
+    mutable ColumnValueSet mValueSet;
+};
+
+typedef CaptureSection<KEY>   KeySection;
+typedef CaptureSection<VALUE> ValueSection;
+
+// the section has always at least one column
+template <class T>
+KeySection key(const Column<T>& pColumn)
+{
+    KeySection section;
+    section(pColumn);
+    return section;
+}
+
+template <class T>
+ValueSection value(const Column<T>& pColumn)
+{
+    ValueSection section;
+    section(pColumn);
+    return section;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CaptureRule: which value is provided by single VALUE section, only UPDATE
+// may have two VALUE sections
+///////////////////////////////////////////////////////////////////////////////
+
+template <OperationType T>
+struct CaptureRule;
+
+template <>
+struct CaptureRule<INSERT>
+{
+    enum { isValueBefore = 0 };
+};
+
+template <>
+struct CaptureRule<DELETE>
+{
+    enum { isValueBefore = 1 };
+};
+
+template <>
+struct CaptureRule<UPDATE>
+{
+    enum { isValueBefore = 0 };  // before from matching SELECT
+    typedef void BeforeAfter;
+};
+
+template <>
+struct CaptureRule<SELECT>
+{
+    enum { isValueBefore = 1 };
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// logUndo: log UNDO operation for entity of specified type assigning it
+// to the previously initialized batch
+///////////////////////////////////////////////////////////////////////////////
+
+template <OperationType T>
+void logUndo(Symbol              pEntity,
+             const KeySection&   pKey,
+             const ValueSection& pValue)
+{
+    ColumnValueSet* value = &pValue.getValueSet();
+    logUndoValueSets(T,
+                     pEntity,
+                     pKey.getValueSet(),
+                     CaptureRule<T>::isValueBefore ? value : NULL,
+                     CaptureRule<T>::isValueBefore ? NULL : value);
+}
+
+// values before and after: UPDATE only
+template <OperationType T>
+typename CaptureRule<T>::BeforeAfter logUndo(Symbol              pEntity,
+                                             const KeySection&   pKey,
+                                             const ValueSection& pValueBefore,
+                                             const ValueSection& pValueAfter)
+{
+    logUndoValueSets(T,
+                     pEntity,
+                     pKey.getValueSet(),
+                     &pValueBefore.getValueSet(),
+                     &pValueAfter.getValueSet());
+}
+
+}
+
+#endif
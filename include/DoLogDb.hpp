@@ -44,6 +44,26 @@
 // Max in memory LONG VARCHAR variable buffer size
 #define MAX_XML_SIZE       10000000
 
+// Size of the length prefix (ub4) of LONG VARCHAR host variable
+#define LONG_VARCHAR_LEN_SIZE 4
+
+// Array INSERT of XML records: max and default number of rows inserted with
+// one statement and the size of one XML slot of the array, the images bigger
+// than the slot are inserted one by one
+#define MAX_INSERT_ARRAY_SIZE     1000
+#define DEFAULT_INSERT_ARRAY_SIZE 100
+#define MAX_XML_ARRAY_SLOT_SIZE   65536
+
+// Number of UNDO_TRANS_LOG_ID values reserved from the sequence at once
+#define SEQNO_BLOCK_SIZE          32
+
+// Load of XML records parsed by parser threads: max and default number of
+// the threads, 1 - parsed serially, and number of records fetched ahead
+// for each thread
+#define MAX_LOAD_WORKER_COUNT     32
+#define DEFAULT_LOAD_WORKER_COUNT 1
+#define LOAD_JOBS_PER_WORKER      2
+
 // field sizes
 #define MAX_ROWID_LEN      32
 #define MAX_ERRMSG_LEN     256
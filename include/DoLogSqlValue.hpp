@@ -46,9 +46,15 @@
 #include <stdexcept>
 #include <sstream>
 
+#include "DoLogXmlSink.hpp"
+#include "DoLogArena.hpp"
+#include "DoLogSymbol.hpp"
+
 namespace dolog
 {
 
+class BinaryWriter;
+
 template <class T>
 int any2int(const T& t)
 {
@@ -91,36 +97,79 @@ typedef enum SqlValueType
 
 } SqlValueType;
 
-std::string xmlEscCharDecode(SqlValueType pType, std::string pString);
-std::string xmlEscCharEncode(SqlValueType pType, std::string pString);
+std::string xmlEscCharDecode(SqlValueType pType, const std::string& pString);
+void xmlEscCharEncode(SqlValueType pType, const char* pData, size_t pLength, XmlSink& pSink);
 
 ////////////////////////////////////////////////////////////////////////////////
-// SqlValue: representation of sql value, ready to show in XML
+// SqlValue: representation of sql value. The value captured from the host
+// variable is kept in its native form and it is formatted only when XML or
+// SQL is rendered. The values decoded from XML are kept as strings.
 ////////////////////////////////////////////////////////////////////////////////
 
 typedef std::map <std::string, std::string> String2StringMap;
 
-class SqlValue
+// native form of the value stored
+typedef enum SqlValueStorage
+{
+    SQL_STORE_STRING = 0, // mValueString
+    SQL_STORE_INT    = 1,
+    SQL_STORE_SHORT  = 2,
+    SQL_STORE_FLOAT  = 3,
+    SQL_STORE_DOUBLE = 4,
+    SQL_STORE_LONG   = 5,
+    SQL_STORE_CHARS  = 6  // short char sequence stored inline
+
+} SqlValueStorage;
+
+// max length of char sequence stored inline, the longer ones go to string
+#define SQL_VALUE_INLINE_LEN 32
+
+// size of buffer big enough for any formatted numeric value
+#define SQL_VALUE_FORMAT_LEN 32
+
+class SqlValue : public ArenaObject // allocated in the arena of the log
 {
 public:
     SqlValue(SqlValueType pType,
-             std::string  pLabel,
+             Symbol       pLabel,
              std::string  pValueString);
     SqlValue(SqlValueType pType,
-             std::string  pLabel);
+             Symbol       pLabel);
     virtual ~SqlValue();
     virtual SqlValue*    clone() = 0;
     virtual std::string  getValue() = 0;
     std::string          getString();
-    std::string          getLabel();
+    const std::string&   getLabel();
+    Symbol               getLabelSymbol();
     void                 setAttribute(std::string pAttribute,
                                       std::string pAttributeValue);
-    std::string          getXmlAttributes();
-    std::string          getXml();
+    void                 writeXmlAttributes(XmlSink& pSink);
+    void                 writeXml(XmlSink& pSink);
+    void                 writeBinary(BinaryWriter& pWriter);
 protected:
+    void                 setInt(int pValue);
+    void                 setShort(short pValue);
+    void                 setFloat(float pValue);
+    void                 setDouble(double pValue);
+    void                 setLong(long pValue);
+    void                 setChars(const char* pValue,
+                                  size_t      pLength);
+    const char*          formatValue(char*   pBuffer,
+                                     size_t& pLength);
     SqlValueType         mTypeId;
     String2StringMap     mAttribute;
-    std::string          mLabel;
+    Symbol               mLabel;
+    SqlValueStorage      mStorage;
+    unsigned short       mCharsLength;
+    union
+    {
+        int              mInt;
+        short            mShort;
+        float            mFloat;
+        double           mDouble;
+        long             mLong;
+        char             mChars[SQL_VALUE_INLINE_LEN];
+    };
     std::string          mValueString;
 };
 
@@ -131,11 +180,11 @@ protected:
 class SqlChar : public SqlValue
 {
 public:
-    SqlChar(std::string pLabel,
+    SqlChar(Symbol      pLabel,
             std::string pValueString);
-    SqlChar(std::string pLabel,
+    SqlChar(Symbol      pLabel,
             char*       pValueChar);
-    SqlChar(std::string pLabel,
+    SqlChar(Symbol      pLabel,
             void*       pValueAny);
     SqlChar*    clone();
     std::string getValue();
@@ -148,11 +197,11 @@ public:
 class SqlInteger : public SqlValue
 {
 public:
-    SqlInteger(std::string pLabel,
+    SqlInteger(Symbol      pLabel,
                std::string pValueString);
-    SqlInteger(std::string pLabel,
+    SqlInteger(Symbol      pLabel,
                int         pValueInt);
-    SqlInteger(std::string pLabel,
+    SqlInteger(Symbol      pLabel,
                void*       pValueAny);
     SqlInteger* clone();
     std::string getValue();
@@ -165,11 +214,11 @@ public:
 class SqlSmallint : public SqlValue
 {
 public:
-    SqlSmallint(std::string pLabel,
+    SqlSmallint(Symbol      pLabel,
                 std::string pValueString);
-    SqlSmallint(std::string pLabel,
+    SqlSmallint(Symbol      pLabel,
                 short       pValueShort);
-    SqlSmallint(std::string pLabel,
+    SqlSmallint(Symbol      pLabel,
                 void*       pValueAny);
     SqlSmallint* clone();
     std::string  getValue();
@@ -182,11 +231,11 @@ public:
 class SqlFloat : public SqlValue
 {
 public:
-    SqlFloat(std::string pLabel,
+    SqlFloat(Symbol      pLabel,
              std::string pValueString);
-    SqlFloat(std::string pLabel,
+    SqlFloat(Symbol      pLabel,
              float       pValueFloat);
-    SqlFloat(std::string pLabel,
+    SqlFloat(Symbol      pLabel,
              void*       pValueAny);
     SqlFloat*   clone();
     std::string getValue();
@@ -199,11 +248,11 @@ public:
 class SqlDouble : public SqlValue
 {
 public:
-    SqlDouble(std::string pLabel,
+    SqlDouble(Symbol      pLabel,
               std::string pValueString);
-    SqlDouble(std::string pLabel,
+    SqlDouble(Symbol      pLabel,
               double      pValueDouble);
-    SqlDouble(std::string pLabel,
+    SqlDouble(Symbol      pLabel,
               void*       pValueAny);
     SqlDouble*  clone();
     std::string getValue();
@@ -216,12 +265,12 @@ public:
 class SqlDate : public SqlValue
 {
 public:
-    SqlDate(std::string pLabel,
+    SqlDate(Symbol      pLabel,
             std::string pValueString);
-    SqlDate(std::string pLabel,
+    SqlDate(Symbol      pLabel,
             std::string pValueString,
             std::string pFormatMask);
-    SqlDate(std::string pLabel,
+    SqlDate(Symbol      pLabel,
             void*       pValueAny);
     SqlDate*    clone();
     std::string getValue();
@@ -243,9 +292,9 @@ typedef struct
 class SqlVarchar : public SqlValue
 {
 public:
-    SqlVarchar(std::string pLabel,
+    SqlVarchar(Symbol      pLabel,
                std::string pValueString);
-    SqlVarchar(std::string pLabel,
+    SqlVarchar(Symbol      pLabel,
                void*       pValueAny);
     SqlVarchar* clone();
     std::string getValue();
@@ -258,11 +307,13 @@ public:
 class SqlLong : public SqlValue
 {
 public:
-    SqlLong(std::string pLabel,
+    SqlLong(Symbol      pLabel,
             std::string pValueString);
-    SqlLong(std::string pLabel,
+    SqlLong(Symbol      pLabel,
             int         pValueInt);
-    SqlLong(std::string pLabel,
+    SqlLong(Symbol      pLabel,
+            long        pValueLong);
+    SqlLong(Symbol      pLabel,
             void*       pValueAny);
     SqlLong* clone();
     std::string getValue();
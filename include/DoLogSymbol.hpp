@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogSymbol.hpp
+// Description: Provides process wide table of interned names of columns and
+//              entities. The values and operations refer to their names with
+//              small integer ids, the name is resolved only upon rendering.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-12
+// Abstract   : Provides table of interned names.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#ifndef DoLogSymbol_hpp
+#define DoLogSymbol_hpp
+
+#include <string>
+
+namespace dolog
+{
+
+// initial number of slots of the symbol table, always power of 2
+#define SYMBOL_TABLE_INIT_SIZE 1024
+
+typedef unsigned int SymbolId;
+
+///////////////////////////////////////////////////////////////////////////////
+// Symbol: interned name, the same names have always the same id. The names
+// known are looked up without lock, only a new name is interned under lock.
+// The symbol keeps reference to its name so it is read without lock by any
+// thread.
+///////////////////////////////////////////////////////////////////////////////
+
+class Symbol
+{
+public:
+    Symbol();
+    Symbol(const char*        pName);
+    Symbol(const char*        pName,
+           size_t             pLength);
+    Symbol(const std::string& pName);
+    SymbolId                  getId() const { return mId; }
+    const std::string&        getName() const { return *mName; }
+    bool                      operator==(const Symbol& rhs) const { return mId == rhs.mId; }
+    bool                      operator!=(const Symbol& rhs) const { return mId != rhs.mId; }
+    bool                      operator<(const Symbol& rhs) const { return mId < rhs.mId; }
+    static bool               find(const std::string& pName,
+                                   Symbol&            pSymbol);
+    static size_t             getCount();
+private:
+    SymbolId                  mId;
+    const std::string*        mName;
+};
+
+}
+
+#endif
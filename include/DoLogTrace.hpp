@@ -48,8 +48,15 @@
 // 2 - logical (functional) record level
 // 3 - DB level and record details
 // 4 - parser level
+// The level is checked before anything is formatted, the levels above
+// DOLOG_TRACE_CEILING are removed by the compiler.
 ///////////////////////////////////////////////////////////////////////////////
 
+// highest trace level compiled in, may be set with -DDOLOG_TRACE_CEILING=N
+#ifndef DOLOG_TRACE_CEILING
+#define DOLOG_TRACE_CEILING 4
+#endif
+
 namespace dolog
 {
 
@@ -57,9 +64,32 @@ class Trace
 {
 public:
     // store the level and name, all calls to Trace methods will use it
-    Trace(int pLevel, const char* pFunctionName);
+    Trace(int pLevel, const char* pFunctionName)
+        : mCurrentFunctionName(pFunctionName),
+          mCurrentFunctionTraceLevel(pLevel),
+          mEnabled(isEnabled(pLevel))
+    {
+        if (mEnabled)
+        {
+            enter();
+        }
+    }
     // print info upon destruction while exiting from current context (also function)
-    ~Trace();
+    ~Trace()
+    {
+        if (mEnabled)
+        {
+            leave();
+        }
+    }
+    // is the trace of current function to be printed
+    bool isEnabled() const { return mEnabled; }
+    // is the trace on given level to be printed
+    static bool isEnabled(int pLevel)
+    {
+        return pLevel <= DOLOG_TRACE_CEILING &&
+               pLevel <= (sLevel >= 0 ? sLevel : loadLevel());
+    }
     // print general info about step of execution
     void info(const std::string& pMessage);
     // use debug message
@@ -78,9 +108,14 @@ public:
     static void setLevel(int traceLevel);
 
 private:
-    std::string mCurrentFunctionName;
+    void        enter();
+    void        leave();
+    static int  loadLevel();
+    const char* mCurrentFunctionName;
     int         mCurrentFunctionTraceLevel;
-    static int  sCallLevel;
+    bool        mEnabled;
+    static __thread int sCallLevel; // nesting in the calling thread
+    static volatile int sLevel; // copy of trace level, -1 - not known yet
 
 protected:
     // trace message format: [CALL_LEVEL_N]<N Spaces><FunctionName> message
@@ -90,7 +125,8 @@ protected:
 }
 
 #define TRACE(level, fname) Trace __f__(level, fname)
-#define TRACE_MSG(msg) __f__.trace(msg)
+// the message is built only if it is to be printed
+#define TRACE_MSG(msg) if (!__f__.isEnabled()) ; else __f__.trace(msg)
 #define INFO(msg) DOLOG_LOG_STREAM << msg << std::endl;
 #define ERROR(msg) __f__.error(msg)
 #define ERROR_CODE(code, msg) __f__.errorCode(code, msg)
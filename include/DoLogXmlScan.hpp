@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogXmlScan.hpp
+// Description: Scanning of XML text for markup and special characters used
+//              by the XML parser and by the escaping of SQL values. The bytes
+//              are compared 16 at once with SSE2 if the target has it.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-04-01
+// Abstract   : Vectorized scanning of XML text.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#ifndef DoLogXmlScan_hpp
+#define DoLogXmlScan_hpp
+
+#include <cstddef>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace dolog
+{
+
+//
+// First byte equal to any of the given ones, pEnd - none found
+//
+inline const char* xmlScanFor(const char* pBegin,
+                              const char* pEnd,
+                              char        pA,
+                              char        pB,
+                              char        pC)
+{
+    const char* p = pBegin;
+#ifdef __SSE2__
+    const __m128i a = _mm_set1_epi8(pA);
+    const __m128i b = _mm_set1_epi8(pB);
+    const __m128i c = _mm_set1_epi8(pC);
+    while (pEnd - p >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, a),
+                                                  _mm_cmpeq_epi8(block, b)),
+                                     _mm_cmpeq_epi8(block, c));
+        int mask = _mm_movemask_epi8(match);
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < pEnd && *p != pA && *p != pB && *p != pC)
+    {
+        p++;
+    }
+
+    return p;
+}
+
+//
+// First character to be escaped in XML text: <>"'&, pEnd - none found
+//
+inline const char* xmlScanSpecial(const char* pBegin,
+                                  const char* pEnd)
+{
+    const char* p = pBegin;
+#ifdef __SSE2__
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i quot = _mm_set1_epi8('"');
+    const __m128i apos = _mm_set1_epi8('\'');
+    const __m128i amp = _mm_set1_epi8('&');
+    while (pEnd - p >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)p);
+        __m128i match = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, lt),
+                                                  _mm_cmpeq_epi8(block, gt)),
+                                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, quot),
+                                                               _mm_cmpeq_epi8(block, apos)),
+                                                  _mm_cmpeq_epi8(block, amp)));
+        int mask = _mm_movemask_epi8(match);
+        if (mask)
+        {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < pEnd &&
+           *p != '<' && *p != '>' && *p != '"' && *p != '\'' && *p != '&')
+    {
+        p++;
+    }
+
+    return p;
+}
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+//Copyright (c) 2014 Ericsson
+//
+//The copyright in this work is vested in Ericsson Telekommunikation GmbH
+//(hereafter "Ericsson"). The information contained in this work (either in whole
+//or in part) is confidential and must not be modified, reproduced, disclosed or
+//disseminated to others or used for purposes other than that for which it is
+//supplied, without the prior written permission of Ericsson. If this work or any
+//part hereof is furnished to a third party by virtue of a contract with that
+//party, use of this work by such party shall be governed by the express
+//contractual terms between Ericsson, which is party to that contract and the
+//said party.
+//
+//The information in this document is subject to change without notice and
+//should not be construed as a commitment by Ericsson. Ericsson assumes no
+//responsibility for any errors that may appear in this document. With the
+//appearance of a new version of this document all older versions become
+//invalid.
+//
+//All rights reserved.
+//
+// Program    : BAT++ UNDOLOG
+// File       : DoLogXmlSink.hpp
+// Description: Provides append only output buffers used for rendering of the
+//              XML image of the log. All levels of the log structure (values,
+//              operations, batches) write their XML directly into the sink
+//              so no temporary strings are built on the way. The sink decides
+//              where the image goes: file or growable memory buffer.
+// Author(s)  : Norbert Bondarczuk
+// Created    : 2015-03-02
+// Abstract   : Provides XML output sinks.
+//
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * static char *SCCS_VERSION = "%I%";
+ */
+
+#ifndef DoLogXmlSink_hpp
+#define DoLogXmlSink_hpp
+
+#include <string>
+#include <iostream>
+
+#include <string.h>
+
+namespace dolog
+{
+
+///////////////////////////////////////////////////////////////////////////////
+// XmlSink: append only output, the subclasses provide the storage
+///////////////////////////////////////////////////////////////////////////////
+
+class XmlSink
+{
+public:
+    virtual ~XmlSink();
+    virtual void write(const char* pData,
+                       size_t      pLength) = 0;
+    XmlSink&     operator<<(const std::string& pString);
+    XmlSink&     operator<<(const char* pString);
+    XmlSink&     operator<<(char pChar);
+    XmlSink&     operator<<(int pValue);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// XmlFileSink: the image goes directly to the (buffered) output stream
+///////////////////////////////////////////////////////////////////////////////
+
+class XmlFileSink : public XmlSink
+{
+public:
+    XmlFileSink(std::ostream& pOutput);
+    void          write(const char* pData,
+                        size_t      pLength);
+private:
+    std::ostream& mOutput;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// XmlMemorySink: growable memory buffer reused by consecutive images. Optional
+// header space is kept in front of the image so that the buffer can be used
+// directly as the host variable with a length prefix (Oracle LONG VARCHAR).
+///////////////////////////////////////////////////////////////////////////////
+
+class XmlMemorySink : public XmlSink
+{
+public:
+    XmlMemorySink(size_t pHeaderSize = 0);
+    ~XmlMemorySink();
+    void          write(const char* pData,
+                        size_t      pLength);
+    void          clear();
+    const char*   data();     // the image
+    size_t        length();   // the image length
+    char*         buffer();   // the header followed by the image
+    size_t        capacity();
+    std::string   str();
+private:
+    XmlMemorySink(const XmlMemorySink&);
+    XmlMemorySink& operator=(const XmlMemorySink&);
+    void          reserve(size_t pSize);
+    char*         mBuffer;
+    size_t        mHeaderSize;
+    size_t        mLength;
+    size_t        mCapacity;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// XmlFixedSink: the image goes into memory of fixed size provided by the caller
+// (a slot of the host array). The image not fitting into it is marked as
+// overflow and has to be rendered again into a growable sink.
+///////////////////////////////////////////////////////////////////////////////
+
+class XmlFixedSink : public XmlSink
+{
+public:
+    XmlFixedSink(char*  pBuffer,
+                 size_t pCapacity);
+    void          write(const char* pData,
+                        size_t      pLength);
+    size_t        length();
+    bool          isOverflow();
+private:
+    char*         mBuffer;
+    size_t        mLength;
+    size_t        mCapacity;
+    bool          mIsOverflow;
+};
+
+}
+
+#endif